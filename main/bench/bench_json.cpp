@@ -0,0 +1,273 @@
+/*
+ *  Copyright (C) 2014 Marcel Lehwald
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <value.h>
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QList>
+
+#include <cstdio>
+#include <cstdlib>
+
+using namespace hfsmexec;
+
+/*
+ * allocator calls
+ */
+// Qt containers allocate with malloc/realloc directly, so those are interposed rather than operator new
+static bool countAllocations = false;
+static long allocations = 0;
+
+#ifdef __GLIBC__
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_realloc(void* p, size_t size);
+
+extern "C" void* malloc(size_t size) {
+    if (countAllocations) {
+        allocations++;
+    }
+
+    return __libc_malloc(size);
+}
+
+extern "C" void* realloc(void* p, size_t size) {
+    if (countAllocations) {
+        allocations++;
+    }
+
+    return __libc_realloc(p, size);
+}
+#endif
+
+/*
+ * messages
+ */
+QByteArray pointCloud(int points) {
+    Value message;
+    message["op"] = "publish";
+    message["topic"] = "/camera/depth/points";
+    message["msg"]["header"]["frame_id"] = "camera_depth_optical_frame";
+    message["msg"]["header"]["seq"] = 4711;
+    for (int i = 0; i < points * 3; i++) {
+        message["msg"]["data"][i] = (i % 640) * 0.001953125 - 0.625;
+    }
+
+    QByteArray json;
+    message.toJson(json);
+
+    return json;
+}
+
+QByteArray poseArray(int poses) {
+    Value message;
+    message["op"] = "publish";
+    message["topic"] = "/robot/poses";
+    message["msg"]["header"]["frame_id"] = "base_link";
+    for (int i = 0; i < poses; i++) {
+        Value& pose = message["msg"]["poses"][i];
+        pose["position"]["x"] = i * 0.1;
+        pose["position"]["y"] = i * -0.2;
+        pose["position"]["z"] = 0.5;
+        pose["orientation"]["x"] = 0.0;
+        pose["orientation"]["y"] = 0.0;
+        pose["orientation"]["z"] = 0.7071067811865476;
+        pose["orientation"]["w"] = 0.7071067811865476;
+    }
+
+    QByteArray json;
+    message.toJson(json);
+
+    return json;
+}
+
+QByteArray jointTrajectory(int points, int joints) {
+    Value message;
+    message["op"] = "publish";
+    message["topic"] = "/arm/joint_trajectory";
+    for (int j = 0; j < joints; j++) {
+        message["msg"]["joint_names"][j] = QString("joint_%1").arg(j);
+    }
+    for (int i = 0; i < points; i++) {
+        Value& point = message["msg"]["points"][i];
+        for (int j = 0; j < joints; j++) {
+            point["positions"][j] = 0.01 * i + j;
+            point["velocities"][j] = 0.25;
+        }
+        point["time_from_start"]["secs"] = i / 10;
+        point["time_from_start"]["nsecs"] = (i % 10) * 100000000;
+    }
+
+    QByteArray json;
+    message.toJson(json);
+
+    return json;
+}
+
+/*
+ * benchmark
+ */
+void benchmark(const QString& name, const QList<QByteArray>& messages, int iterations) {
+    long bytes = 0;
+    for (int i = 0; i < messages.size(); i++) {
+        bytes += messages[i].size();
+    }
+
+    // decode every message once to check it
+    for (int i = 0; i < messages.size(); i++) {
+        Value value;
+        if (!value.fromJson(messages[i].constData(), messages[i].size())) {
+            printf("%s: message %d is not valid JSON\n", name.toStdString().c_str(), i);
+
+            return;
+        }
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    for (int n = 0; n < iterations; n++) {
+        for (int i = 0; i < messages.size(); i++) {
+            Value value;
+            value.fromJson(messages[i].constData(), messages[i].size());
+        }
+    }
+    qint64 ns = timer.nsecsElapsed();
+
+    printf("%-40s %8d messages %10ld bytes %10.1f MB/s\n", name.toStdString().c_str(), messages.size(), bytes, (double)bytes * iterations / ns * 1000.0);
+}
+
+void replay(const QString& name, const QList<QByteArray>& messages, int count = 10000) {
+    // plain decoding, every message is freed value by value
+    allocations = 0;
+    countAllocations = true;
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < count; i++) {
+        const QByteArray& message = messages[i % messages.size()];
+        Value value;
+        value.fromJson(message.constData(), message.size());
+    }
+    qint64 heapNs = timer.nsecsElapsed();
+    countAllocations = false;
+    long heapAllocations = allocations;
+
+    // decoding into an arena which is reset after every message, like Rosbridge::read
+    ValueArena arena;
+    allocations = 0;
+    countAllocations = true;
+    timer.restart();
+    for (int i = 0; i < count; i++) {
+        const QByteArray& message = messages[i % messages.size()];
+        arena.reset();
+        Value value;
+        ValueArena::Scope scope(&arena);
+        value.fromJson(message.constData(), message.size());
+    }
+    qint64 arenaNs = timer.nsecsElapsed();
+    countAllocations = false;
+    long arenaAllocations = allocations;
+
+    printf("%-40s %8d messages %8.1f / %8.1f allocations per message %8.2f / %8.2f us per message (heap / arena)\n", name.toStdString().c_str(), count,
+           (double)heapAllocations / count, (double)arenaAllocations / count, heapNs / 1000.0 / count, arenaNs / 1000.0 / count);
+}
+
+void filter(const QString& name, const QList<QByteArray>& messages, int count = 10000) {
+    // a listener waiting for another topic, as in RosCommunicationPlugin::subscribeMessage
+    Value topic = "/other/topic";
+    volatile int matches = 0;
+
+    allocations = 0;
+    countAllocations = true;
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < count; i++) {
+        const QByteArray& message = messages[i % messages.size()];
+        Value value;
+        value.fromJson(message.constData(), message.size());
+        if (value["op"].getString() == "publish" && value["topic"] == topic) {
+            matches++;
+        }
+    }
+    qint64 valueNs = timer.nsecsElapsed();
+    countAllocations = false;
+    long valueAllocations = allocations;
+
+    allocations = 0;
+    countAllocations = true;
+    timer.restart();
+    for (int i = 0; i < count; i++) {
+        const QByteArray& message = messages[i % messages.size()];
+        ValueView view;
+        view.fromJson(message.constData(), message.size());
+        if (view["op"] == "publish" && view["topic"] == topic) {
+            matches++;
+        }
+    }
+    qint64 viewNs = timer.nsecsElapsed();
+    countAllocations = false;
+    long viewAllocations = allocations;
+
+    printf("%-40s %8d messages %8.1f / %8.1f allocations per message %8.2f / %8.2f us per message (value / view)\n", name.toStdString().c_str(), count,
+           (double)valueAllocations / count, (double)viewAllocations / count, valueNs / 1000.0 / count, viewNs / 1000.0 / count);
+}
+
+/*
+ * main
+ */
+int main(int argc, char** argv) {
+    printf("\n== Value::fromJson ==\n");
+
+    // recorded rosbridge messages, one JSON message per line as read by Rosbridge::read
+    if (argc > 1) {
+        for (int i = 1; i < argc; i++) {
+            QFile file(argv[i]);
+            if (!file.open(QIODevice::ReadOnly)) {
+                printf("couldn't open %s\n", argv[i]);
+
+                return 1;
+            }
+
+            QList<QByteArray> messages;
+            while (!file.atEnd()) {
+                QByteArray line = file.readLine().trimmed();
+                if (!line.isEmpty()) {
+                    messages.append(line);
+                }
+            }
+
+            benchmark(argv[i], messages, 10);
+            replay(argv[i], messages);
+            filter(argv[i], messages);
+        }
+
+        return 0;
+    }
+
+    benchmark("point cloud (20k points)", QList<QByteArray>() << pointCloud(20000), 20);
+    benchmark("pose array (1000 poses)", QList<QByteArray>() << poseArray(1000), 20);
+    benchmark("joint trajectory (500 points, 7 joints)", QList<QByteArray>() << jointTrajectory(500, 7), 20);
+
+    printf("\n== Value::fromJson replay ==\n");
+
+    replay("mixed topics", QList<QByteArray>() << pointCloud(1000) << poseArray(50) << jointTrajectory(20, 7));
+
+    printf("\n== Rosbridge listener filtering ==\n");
+
+    filter("mixed topics", QList<QByteArray>() << pointCloud(1000) << poseArray(50) << jointTrajectory(20, 7));
+
+    return 0;
+}
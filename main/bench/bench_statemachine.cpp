@@ -0,0 +1,444 @@
+/*
+ *  Copyright (C) 2014 Marcel Lehwald
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <application.h>
+#include <builder.h>
+#include <eventqueue.h>
+#include <statemachine.h>
+#include <topology.h>
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QThread>
+
+#include <cstdio>
+#include <functional>
+
+using namespace hfsmexec;
+
+/*
+ * benchmark
+ */
+template<typename F>
+void benchmark(const char* name, int iterations, F f) {
+    // warm up
+    f();
+
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < iterations; i++) {
+        f();
+    }
+    qint64 ns = timer.nsecsElapsed();
+
+    printf("%-50s %12.1f ns/op\n", name, (double)ns / iterations);
+}
+
+/*
+ * state machines
+ */
+// parallel regions, each one toggling between two states on its own event
+StateMachine* buildParallel(int regions) {
+    StateMachineBuilder builder;
+    builder <<new StateMachine("root", "parallel");
+    builder <<new ParallelState("parallel", "root");
+    for (int i = 0; i < regions; i++) {
+        QString region = QString("region%1").arg(i);
+        QString a = QString("a%1").arg(i);
+        QString b = QString("b%1").arg(i);
+        QString event = QString("event%1").arg(i);
+
+        builder <<new CompositeState(region, a, "parallel");
+        builder <<new ParallelState(a, region);
+        builder <<new ParallelState(b, region);
+        builder <<new ConditionalTransition(a + b, a, b, event);
+        builder <<new ConditionalTransition(b + a, b, a, event);
+    }
+
+    return builder.build();
+}
+
+// two branches of nested composite states, the leaves at the bottom toggle between the branches
+StateMachine* buildDeep(int depth) {
+    StateMachineBuilder builder;
+    builder <<new StateMachine("root", "l0");
+    for (int i = 0; i < depth; i++) {
+        QString parentLeft = i > 0 ? QString("l%1").arg(i - 1) : QString("root");
+        QString parentRight = i > 0 ? QString("r%1").arg(i - 1) : QString("root");
+        builder <<new CompositeState(QString("l%1").arg(i), QString("l%1").arg(i + 1), parentLeft);
+        builder <<new CompositeState(QString("r%1").arg(i), QString("r%1").arg(i + 1), parentRight);
+    }
+
+    QString left = QString("l%1").arg(depth);
+    QString right = QString("r%1").arg(depth);
+    builder <<new ParallelState(left, QString("l%1").arg(depth - 1));
+    builder <<new ParallelState(right, QString("r%1").arg(depth - 1));
+    builder <<new ConditionalTransition("leftright", left, right, "toggle");
+    builder <<new ConditionalTransition("rightleft", right, left, "toggle");
+
+    return builder.build();
+}
+
+// groups of 100 states under the root, each state has a transition to the next one of its group
+StateMachine* buildWide(int states, qint64* buildNs) {
+    StateMachineBuilder builder;
+    builder <<new StateMachine("root", "g0");
+    for (int i = 0; i < states; i++) {
+        QString group = QString("g%1").arg(i / 100);
+        QString state = QString("s%1").arg(i);
+        if (i % 100 == 0) {
+            builder <<new CompositeState(group, state, "root");
+        }
+
+        builder <<new ParallelState(state, group);
+        if (i % 100 != 99 && i + 1 < states) {
+            builder <<new ConditionalTransition(state + "next", state, QString("s%1").arg(i + 1), "next");
+        }
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    StateMachine* stateMachine = builder.build();
+    *buildNs = timer.nsecsElapsed();
+
+    return stateMachine;
+}
+
+void benchmarkBuild() {
+    printf("\n== StateMachineBuilder ==\n");
+
+    int counts[] = {100, 1000, 10000, 100000};
+    for (int c = 0; c < 4; c++) {
+        qint64 ns = 0;
+        StateMachine* stateMachine = buildWide(counts[c], &ns);
+
+        QByteArray name = QString("build, %1 states").arg(counts[c]).toUtf8();
+        printf("%-50s %12.1f ms %8.1f us/state\n", name.constData(), ns / 1e6, ns / 1e3 / counts[c]);
+
+        // lookups by id after the build
+        QString stateId = QString("s%1").arg(counts[c] - 1);
+        AbstractState* group = stateMachine->getState(QString("g%1").arg((counts[c] - 1) / 100));
+        AbstractState* found = NULL;
+        name = QString("getState, %1 states").arg(counts[c]).toUtf8();
+        benchmark(name.constData(), 100000, [&]() {
+            found = stateMachine->getState(stateId);
+        });
+
+        name = QString("getChildState, %1 states").arg(counts[c]).toUtf8();
+        benchmark(name.constData(), 100000, [&]() {
+            found = group->getChildState(stateId);
+        });
+
+        delete stateMachine;
+    }
+}
+
+// the lookup without topology, for comparison
+AbstractState* findRecursive(AbstractState* state, const QString& stateId) {
+    if (state->getId() == stateId) {
+        return state;
+    }
+
+    const QList<AbstractState*>& childStates = state->getChildStates();
+    for (int i = 0; i < childStates.size(); i++) {
+        AbstractState* found = findRecursive(childStates[i], stateId);
+        if (found != NULL) {
+            return found;
+        }
+    }
+
+    return NULL;
+}
+
+void benchmarkDeep() {
+    printf("\n== StateMachine 50 level hierarchy ==\n");
+
+    const int depth = 50;
+    benchmark("build", 100, [&]() {
+        delete buildDeep(depth);
+    });
+
+    StateMachine* stateMachine = buildDeep(depth);
+    const StateMachineTopology* topology = stateMachine->getTopology();
+    QString leaf = QString("r%1").arg(depth);
+    AbstractState* found = NULL;
+
+    benchmark("findState, recursive", 100000, [&]() {
+        found = findRecursive(stateMachine, leaf);
+    });
+
+    benchmark("findState, topology", 100000, [&]() {
+        found = stateMachine->findState(leaf);
+    });
+
+    int a = topology->indexOf(stateMachine->findState(QString("l%1").arg(depth)));
+    int b = topology->indexOf(found);
+    int lca = 0;
+    benchmark("lca of the leaves", 100000, [&]() {
+        lca = topology->getLca(a, b);
+    });
+
+    delete stateMachine;
+
+    // every transition exits one branch and enters the other one
+    for (int native = 0; native < 2; native++) {
+        StateMachine* stateMachine = buildDeep(depth);
+        stateMachine->setNativeEngine(native);
+        stateMachine->start();
+        QCoreApplication::processEvents();
+
+        int eventId = AbstractEvent::internEventName("toggle");
+        QByteArray name = QString("%1, leaf to leaf transition").arg(native ? "native" : "qt").toUtf8();
+        benchmark(name.constData(), 10000, [&]() {
+            stateMachine->postEvent(new NamedEvent(eventId));
+            QCoreApplication::processEvents();
+        });
+
+        stateMachine->stop();
+        QCoreApplication::processEvents();
+        delete stateMachine;
+    }
+}
+
+void benchmarkDispatch() {
+    printf("\n== StateMachine event dispatch ==\n");
+
+    int counts[] = {10, 100, 1000};
+    for (int native = 0; native < 2; native++) {
+        const char* engine = native ? "native" : "qt";
+        for (int c = 0; c < 3; c++) {
+            StateMachine* stateMachine = buildParallel(counts[c]);
+            stateMachine->setNativeEngine(native);
+            stateMachine->start();
+            QCoreApplication::processEvents();
+
+            int eventId = AbstractEvent::internEventName(QString("event%1").arg(counts[c] / 2));
+            QByteArray name = QString("%1, %2 transitions, matching event").arg(engine).arg(counts[c] * 2).toUtf8();
+            benchmark(name.constData(), 1000, [&]() {
+                stateMachine->postEvent(new NamedEvent(eventId));
+                QCoreApplication::processEvents();
+            });
+
+            int unknownId = AbstractEvent::findEventName("unknown");
+            name = QString("%1, %2 transitions, unknown event").arg(engine).arg(counts[c] * 2).toUtf8();
+            benchmark(name.constData(), 1000, [&]() {
+                stateMachine->postEvent(new NamedEvent(unknownId));
+                QCoreApplication::processEvents();
+            });
+
+            stateMachine->stop();
+            QCoreApplication::processEvents();
+            delete stateMachine;
+        }
+    }
+}
+
+void benchmarkTransitions() {
+    printf("\n== StateMachine transitions ==\n");
+
+    // one region toggling back and forth, every event takes one transition
+    for (int native = 0; native < 2; native++) {
+        StateMachine* stateMachine = buildParallel(1);
+        stateMachine->setNativeEngine(native);
+        stateMachine->start();
+        QCoreApplication::processEvents();
+
+        int eventId = AbstractEvent::internEventName("event0");
+        const int events = 100000;
+
+        // latency of a single transition, the event loop runs after every event
+        QByteArray name = QString("%1, post and process one event").arg(native ? "native" : "qt").toUtf8();
+        benchmark(name.constData(), events, [&]() {
+            stateMachine->postEvent(new NamedEvent(eventId));
+            QCoreApplication::processEvents();
+        });
+
+        // throughput, all events are queued before they are processed
+        QElapsedTimer timer;
+        timer.start();
+        for (int i = 0; i < events; i++) {
+            stateMachine->postEvent(new NamedEvent(eventId));
+        }
+        QCoreApplication::processEvents();
+        qint64 ns = timer.nsecsElapsed();
+        printf("%-50s %12.0f transitions/s\n", native ? "native, queued events" : "qt, queued events", events * 1e9 / ns);
+
+        stateMachine->stop();
+        QCoreApplication::processEvents();
+        delete stateMachine;
+    }
+}
+
+void benchmarkBurst() {
+    printf("\n== StateMachine event bursts ==\n");
+
+    // a burst of 200 events, posted one by one or as a list
+    for (int native = 0; native < 2; native++) {
+        StateMachine* stateMachine = buildParallel(1);
+        stateMachine->setNativeEngine(native);
+        stateMachine->start();
+        QCoreApplication::processEvents();
+
+        int eventId = AbstractEvent::internEventName("event0");
+        QByteArray name = QString("%1, 200 x postEvent").arg(native ? "native" : "qt").toUtf8();
+        benchmark(name.constData(), 1000, [&]() {
+            for (int i = 0; i < 200; i++) {
+                stateMachine->postEvent(new NamedEvent(eventId));
+            }
+            QCoreApplication::processEvents();
+        });
+
+        name = QString("%1, postEvents of 200").arg(native ? "native" : "qt").toUtf8();
+        benchmark(name.constData(), 1000, [&]() {
+            QList<AbstractEvent*> events;
+            for (int i = 0; i < 200; i++) {
+                events.append(new NamedEvent(eventId));
+            }
+            stateMachine->postEvents(events);
+            QCoreApplication::processEvents();
+        });
+
+        stateMachine->stop();
+        QCoreApplication::processEvents();
+        delete stateMachine;
+    }
+}
+
+/*
+ * producers
+ */
+class Producer : public QThread {
+  public:
+    Producer(int events, std::function<void()> post) :
+        events(events),
+        post(post),
+        ns(0) {
+
+    }
+
+    qint64 getNs() const {
+        return ns;
+    }
+
+  protected:
+    virtual void run() {
+        QElapsedTimer timer;
+        timer.start();
+        for (int i = 0; i < events; i++) {
+            post();
+        }
+        ns = timer.nsecsElapsed();
+    }
+
+  private:
+    int events;
+    std::function<void()> post;
+    qint64 ns;
+};
+
+// runs the producers while the calling thread consumes, reports the mean time of a post and the overall throughput
+void benchmarkProducers(const char* name, int threads, int events, std::function<void()> post, std::function<void()> consume) {
+    QList<Producer*> producers;
+    for (int i = 0; i < threads; i++) {
+        producers.append(new Producer(events, post));
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < threads; i++) {
+        producers[i]->start();
+    }
+
+    bool finished = false;
+    while (!finished) {
+        consume();
+        finished = true;
+        for (int i = 0; i < threads; i++) {
+            finished = finished && producers[i]->isFinished();
+        }
+    }
+    consume();
+    qint64 ns = timer.nsecsElapsed();
+
+    qint64 producerNs = 0;
+    for (int i = 0; i < threads; i++) {
+        producerNs += producers[i]->getNs();
+    }
+    qDeleteAll(producers);
+
+    QByteArray label = QString("%1, %2 producers").arg(name).arg(threads).toUtf8();
+    printf("%-50s %12.1f ns/post %12.0f events/s\n", label.constData(), (double)producerNs / threads / events, (double)threads * events * 1e9 / ns);
+}
+
+void benchmarkIngress() {
+    printf("\n== StateMachine event ingress ==\n");
+
+    int threads[] = {1, 4, 16};
+    for (int t = 0; t < 3; t++) {
+        // the queue alone, the consumer only drains it
+        EventQueue queue(16384);
+        AbstractEvent* events[256];
+        NamedEvent event(1);
+        benchmarkProducers("EventQueue", threads[t], 1000000, [&]() {
+            while (!queue.enqueue(&event)) {
+                QThread::yieldCurrentThread();
+            }
+        }, [&]() {
+            while (queue.dequeue(events, 256) > 0);
+        });
+
+        // posting to a state machine, every event takes a transition
+        for (int native = 0; native < 2; native++) {
+            StateMachine* stateMachine = buildParallel(1);
+            stateMachine->setNativeEngine(native);
+            stateMachine->start();
+            QCoreApplication::processEvents();
+
+            int eventId = AbstractEvent::internEventName("event0");
+            // rejected events are posted again, so only accepted events are counted
+            benchmarkProducers(native ? "native, postEvent" : "qt, postEvent", threads[t], 10000, [&]() {
+                while (!stateMachine->postEvent(new NamedEvent(eventId))) {
+                    QThread::yieldCurrentThread();
+                }
+            }, [&]() {
+                QCoreApplication::processEvents();
+            });
+
+            stateMachine->stop();
+            QCoreApplication::processEvents();
+            delete stateMachine;
+        }
+    }
+}
+
+/*
+ * main
+ */
+int main(int argc, char** argv) {
+    // states report to the API of the application instance
+    Application application(argc, argv);
+    Logger::setLoggerEnabled(false);
+
+    benchmarkDispatch();
+    benchmarkTransitions();
+    benchmarkDeep();
+    benchmarkBuild();
+    benchmarkIngress();
+    benchmarkBurst();
+
+    return 0;
+}
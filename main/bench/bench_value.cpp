@@ -0,0 +1,889 @@
+/*
+ *  Copyright (C) 2014 Marcel Lehwald
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <value.h>
+#include <expression.h>
+
+#include <json/json.h>
+#include <pugixml.hpp>
+
+#include <QElapsedTimer>
+#include <QMap>
+#include <QObject>
+
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <sstream>
+
+#include <unistd.h>
+
+using namespace hfsmexec;
+
+/*
+ * allocation counting (glibc)
+ */
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_calloc(size_t n, size_t size);
+extern "C" void* __libc_realloc(void* p, size_t size);
+
+static bool counting = false;
+static long allocations = 0;
+
+extern "C" void* malloc(size_t size) {
+    if (counting) {
+        allocations++;
+    }
+
+    return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t n, size_t size) {
+    if (counting) {
+        allocations++;
+    }
+
+    return __libc_calloc(n, size);
+}
+
+extern "C" void* realloc(void* p, size_t size) {
+    if (counting) {
+        allocations++;
+    }
+
+    return __libc_realloc(p, size);
+}
+
+/*
+ * benchmark
+ */
+template<typename F>
+void benchmark(const char* name, int iterations, F f) {
+    // warm up
+    f();
+
+    QElapsedTimer timer;
+    allocations = 0;
+    counting = true;
+    timer.start();
+    for (int i = 0; i < iterations; i++) {
+        f();
+    }
+    qint64 ns = timer.nsecsElapsed();
+    counting = false;
+
+    printf("%-40s %12.1f ns/op %10.2f allocs/op\n", name, (double)ns / iterations, (double)allocations / iterations);
+}
+
+/*
+ * layout used by Value before scalars were stored inline: every Value was a QObject owning a std::shared_ptr to a heap
+ * ArbitraryValue, whatever it contained
+ */
+class BaselineArbitraryValue;
+
+class BaselineValue : public QObject {
+  public:
+    typedef QList<BaselineValue> Array;
+    typedef QMap<QString, BaselineValue> Object;
+
+    BaselineValue();
+    BaselineValue(const Value::Boolean& value);
+    BaselineValue(const Value::Integer32& value);
+    BaselineValue(const Value::Float64& value);
+    BaselineValue(const QString& value);
+    BaselineValue(const Array& value);
+    BaselineValue(const Object& value);
+    BaselineValue(const BaselineValue& value);
+
+    BaselineValue& operator=(const BaselineValue& value);
+
+  private:
+    const char* typeNames[8] = {"Undefined", "Null", "Boolean", "Integer", "Float", "String", "Array", "Object"};
+    std::shared_ptr<BaselineArbitraryValue> value;
+};
+
+class BaselineArbitraryValue {
+  public:
+    BaselineArbitraryValue() :
+        type(Value::TYPE_UNDEFINED) {
+        memset(&data, 0, sizeof(data));
+    }
+
+    ~BaselineArbitraryValue() {
+        destroy();
+    }
+
+    template<typename T>
+    void set(Value::Type t, const T& v) {
+        destroy();
+        type = t;
+        new(&data) T(v);
+    }
+
+    void set(const BaselineArbitraryValue& other) {
+        switch (other.type) {
+        case Value::TYPE_STRING:
+            set(other.type, reinterpret_cast<const QString&>(other.data));
+            break;
+        case Value::TYPE_ARRAY:
+            set(other.type, reinterpret_cast<const BaselineValue::Array&>(other.data));
+            break;
+        case Value::TYPE_OBJECT:
+            set(other.type, reinterpret_cast<const BaselineValue::Object&>(other.data));
+            break;
+        default:
+            destroy();
+            type = other.type;
+            memcpy(&data, &other.data, sizeof(data));
+        }
+    }
+
+  private:
+    Value::Type type;
+
+    union Data {
+        bool b;
+        Value::Integer i;
+        Value::Float d;
+        char s[sizeof(QString)];
+        char a[sizeof(BaselineValue::Array)];
+        char o[sizeof(BaselineValue::Object)];
+    } data;
+
+    void destroy() {
+        typedef BaselineValue::Array Array;
+        typedef BaselineValue::Object Object;
+
+        if (type == Value::TYPE_STRING) {
+            reinterpret_cast<QString*>(&data)->~QString();
+        } else if (type == Value::TYPE_ARRAY) {
+            reinterpret_cast<BaselineValue::Array*>(&data)->~Array();
+        } else if (type == Value::TYPE_OBJECT) {
+            reinterpret_cast<BaselineValue::Object*>(&data)->~Object();
+        }
+        type = Value::TYPE_UNDEFINED;
+    }
+};
+
+BaselineValue::BaselineValue() :
+    value(new BaselineArbitraryValue()) {
+    this->value->set(Value::TYPE_NULL, false);
+}
+
+BaselineValue::BaselineValue(const Value::Boolean& value) :
+    value(new BaselineArbitraryValue()) {
+    this->value->set(Value::TYPE_BOOLEAN, value);
+}
+
+BaselineValue::BaselineValue(const Value::Integer32& value) :
+    value(new BaselineArbitraryValue()) {
+    this->value->set(Value::TYPE_INTEGER, static_cast<Value::Integer>(value));
+}
+
+BaselineValue::BaselineValue(const Value::Float64& value) :
+    value(new BaselineArbitraryValue()) {
+    this->value->set(Value::TYPE_FLOAT, value);
+}
+
+BaselineValue::BaselineValue(const QString& value) :
+    value(new BaselineArbitraryValue()) {
+    this->value->set(Value::TYPE_STRING, value);
+}
+
+BaselineValue::BaselineValue(const Array& value) :
+    value(new BaselineArbitraryValue()) {
+    this->value->set(Value::TYPE_ARRAY, value);
+}
+
+BaselineValue::BaselineValue(const Object& value) :
+    value(new BaselineArbitraryValue()) {
+    this->value->set(Value::TYPE_OBJECT, value);
+}
+
+BaselineValue::BaselineValue(const BaselineValue& value) :
+    QObject(),
+    value(new BaselineArbitraryValue()) {
+    this->value->set(*value.value);
+}
+
+BaselineValue& BaselineValue::operator=(const BaselineValue& value) {
+    this->value->set(*value.value);
+
+    return *this;
+}
+
+void benchmarkConstruction() {
+    printf("\n== Value construction, layout before inline scalars ==\n");
+
+    benchmark("Value()", 1000000, []() {
+        BaselineValue v;
+    });
+
+    benchmark("Value(Boolean)", 1000000, []() {
+        BaselineValue v = true;
+    });
+
+    benchmark("Value(Integer)", 1000000, []() {
+        BaselineValue v = 42;
+    });
+
+    benchmark("Value(Float)", 1000000, []() {
+        BaselineValue v = 0.42;
+    });
+
+    QString baselineString = "foobar";
+    benchmark("Value(String)", 1000000, [&]() {
+        BaselineValue v = baselineString;
+    });
+
+    benchmark("Value(Array)", 1000000, []() {
+        BaselineValue v = BaselineValue::Array();
+    });
+
+    benchmark("Value(Object)", 1000000, []() {
+        BaselineValue v = BaselineValue::Object();
+    });
+
+    BaselineValue baselineInteger = 42;
+    benchmark("Value(const Value&) integer", 1000000, [&]() {
+        BaselineValue v = baselineInteger;
+    });
+
+    printf("\n== Value construction ==\n");
+
+    benchmark("Value()", 1000000, []() {
+        Value v;
+    });
+
+    benchmark("Value(Boolean)", 1000000, []() {
+        Value v = true;
+    });
+
+    benchmark("Value(Integer)", 1000000, []() {
+        Value v = 42;
+    });
+
+    benchmark("Value(Float)", 1000000, []() {
+        Value v = 0.42;
+    });
+
+    QString s = "foobar";
+    benchmark("Value(String)", 1000000, [&]() {
+        Value v = s;
+    });
+
+    benchmark("Value(Array)", 1000000, []() {
+        Value v = Value::Array();
+    });
+
+    benchmark("Value(Object)", 1000000, []() {
+        Value v = Value::Object();
+    });
+
+    Value integer = 42;
+    benchmark("Value(const Value&) integer", 1000000, [&]() {
+        Value v = integer;
+    });
+
+    benchmark("status object (3 keys)", 100000, []() {
+        Value v;
+        v["action"] = "state";
+        v["id"] = "state1";
+        v["change"] = "enter";
+    });
+}
+
+Value createNested(int depth, int width) {
+    Value v;
+    if (depth == 0) {
+        for (int i = 0; i < width; i++) {
+            v[i] = i * 0.5;
+        }
+
+        return v;
+    }
+
+    for (int i = 0; i < width; i++) {
+        v[QString("key%1").arg(i)] = createNested(depth - 1, width);
+    }
+
+    return v;
+}
+
+void benchmarkCopyOnWrite() {
+    printf("\n== Value copy on write ==\n");
+
+    // 4 levels of objects with 8 keys each and float arrays as leaves (~37k values)
+    Value input = createNested(4, 8);
+
+    benchmark("copy nested", 100000, [&]() {
+        Value v = input;
+    });
+
+    benchmark("copy nested + read leaf", 100000, [&]() {
+        const Value v = input;
+        v.contains("key0");
+    });
+
+    benchmark("copy nested + modify leaf", 100000, [&]() {
+        Value v = input;
+        v["key0"]["key1"]["key2"]["key3"][0] = 42;
+    });
+
+    // InvokeState::invoke assigns the input to the plugin for every invocation
+    Value pluginInput;
+    benchmark("assign nested plugin input", 100000, [&]() {
+        pluginInput = input;
+    });
+
+    benchmark("toJson nested", 10, [&]() {
+        QString json;
+        input.toJson(json);
+    });
+}
+
+void benchmarkPath() {
+    printf("\n== Value path ==\n");
+
+    Value value;
+    value["output"]["pose"]["position"][2] = 0.42;
+
+    QString path = "output.pose.position[2]";
+    benchmark("getValue(QString)", 100000, [&]() {
+        value.getValue(path);
+    });
+
+    ValuePath compiled(path);
+    benchmark("getValue(ValuePath)", 100000, [&]() {
+        value.getValue(compiled);
+    });
+
+    benchmark("ValuePath(QString)", 100000, [&]() {
+        ValuePath p(path);
+    });
+}
+
+void benchmarkKeys() {
+    printf("\n== Value keys ==\n");
+
+    // rosbridge messages use the same few keys over and over
+    const char* names[] = {"op", "topic", "msg", "id", "action", "change", "type", "service", "args", "values"};
+    const int count = sizeof(names) / sizeof(names[0]);
+
+    // previous object layout
+    QMap<QString, Value> map;
+    Value object;
+    QString keys[count];
+    ValueKey atoms[count];
+    for (int i = 0; i < count; i++) {
+        keys[i] = names[i];
+        atoms[i] = names[i];
+        map.insert(keys[i], i);
+        object[atoms[i]] = i;
+    }
+
+    benchmark("QMap<QString, Value> lookup (10 keys)", 1000000, [&]() {
+        for (int i = 0; i < count; i++) {
+            map.find(keys[i]);
+        }
+    });
+
+    benchmark("Object lookup QString (10 keys)", 1000000, [&]() {
+        for (int i = 0; i < count; i++) {
+            object.contains(keys[i]);
+        }
+    });
+
+    benchmark("Object lookup ValueKey (10 keys)", 1000000, [&]() {
+        for (int i = 0; i < count; i++) {
+            object.contains(atoms[i]);
+        }
+    });
+
+    benchmark("QMap<QString, Value> insert (10 keys)", 100000, [&]() {
+        QMap<QString, Value> m;
+        for (int i = 0; i < count; i++) {
+            m.insert(keys[i], i);
+        }
+    });
+
+    benchmark("Object insert ValueKey (10 keys)", 100000, [&]() {
+        Value o;
+        for (int i = 0; i < count; i++) {
+            o[atoms[i]] = i;
+        }
+    });
+}
+
+/*
+ * jsoncpp path used by Value before the native reader and writer
+ */
+void jsoncppToValue(Value& value, const Json::Value& json) {
+    if (json.isNull()) {
+        value.null();
+    } else if (json.isBool()) {
+        value = json.asBool();
+    } else if (json.isInt()) {
+        value = json.asInt();
+    } else if (json.isDouble()) {
+        value = json.asDouble();
+    } else if (json.isString()) {
+        value = json.asString().c_str();
+    } else if (json.isArray()) {
+        Value::Array array;
+        for (unsigned int i = 0; i < json.size(); i++) {
+            Value v;
+            jsoncppToValue(v, json[i]);
+            array.append(v);
+        }
+        value = array;
+    } else if (json.isObject()) {
+        Value::Object object;
+        for (Json::ValueConstIterator it = json.begin(); it != json.end(); it++) {
+            Value v;
+            jsoncppToValue(v, *it);
+            object.insert(it.memberName(), v);
+        }
+        value = object;
+    }
+}
+
+void valueToJsoncpp(const Value& value, Json::Value& json) {
+    if (value.isBoolean()) {
+        json = value.getBoolean();
+    } else if (value.isInteger()) {
+        json = (int)value.getInteger();
+    } else if (value.isFloat()) {
+        json = value.getFloat();
+    } else if (value.isString()) {
+        json = value.getStringRef().toStdString();
+    } else if (value.isArray()) {
+        const Value::Array& array = value.getArrayRef();
+        json = Json::Value(Json::arrayValue);
+        for (int i = 0; i < array.size(); i++) {
+            valueToJsoncpp(array[i], json[i]);
+        }
+    } else if (value.isObject()) {
+        const Value::Object& object = value.getObjectRef();
+        json = Json::Value(Json::objectValue);
+        for (Value::Object::const_iterator it = object.begin(); it != object.end(); it++) {
+            valueToJsoncpp(it.value(), json[it.key().toStdString()]);
+        }
+    }
+}
+
+void benchmarkJson() {
+    printf("\n== Value JSON ==\n");
+
+    // rosbridge publish message with a pose array
+    Value message;
+    message["op"] = "publish";
+    message["topic"] = "/robot/poses";
+    message["msg"]["header"]["frame_id"] = "base_link";
+    message["msg"]["header"]["seq"] = 42;
+    for (int i = 0; i < 200; i++) {
+        Value& pose = message["msg"]["poses"][i];
+        pose["position"]["x"] = i * 0.1;
+        pose["position"]["y"] = i * -0.2;
+        pose["position"]["z"] = 0.5;
+        pose["orientation"]["x"] = 0.0;
+        pose["orientation"]["y"] = 0.0;
+        pose["orientation"]["z"] = 0.7071067811865476;
+        pose["orientation"]["w"] = 0.7071067811865476;
+    }
+
+    QByteArray json;
+    message.toJson(json);
+    QString jsonString = QString::fromUtf8(json);
+    printf("message size: %d bytes\n", json.size());
+
+    benchmark("fromJson jsoncpp", 1000, [&]() {
+        Json::Value root;
+        Json::Reader reader;
+        reader.parse(jsonString.toStdString(), root);
+        Value v;
+        jsoncppToValue(v, root);
+    });
+
+    benchmark("fromJson(QString)", 1000, [&]() {
+        Value v;
+        v.fromJson(jsonString);
+    });
+
+    benchmark("fromJson(const char*, int)", 1000, [&]() {
+        Value v;
+        v.fromJson(json.constData(), json.size());
+    });
+
+    benchmark("toJson jsoncpp", 1000, [&]() {
+        Json::Value root;
+        valueToJsoncpp(message, root);
+        Json::FastWriter writer;
+        QString s = writer.write(root).c_str();
+    });
+
+    benchmark("toJson(QString)", 1000, [&]() {
+        QString s;
+        message.toJson(s);
+    });
+
+    QByteArray buffer;
+    buffer.reserve(json.size());
+    benchmark("toJson(QByteArray) reused buffer", 1000, [&]() {
+        buffer.resize(0);
+        message.toJson(buffer);
+    });
+
+    QByteArray binary;
+    message.toBinary(binary);
+    printf("binary message size: %d bytes\n", binary.size());
+
+    benchmark("fromBinary(const char*, int)", 1000, [&]() {
+        Value v;
+        v.fromBinary(binary.constData(), binary.size());
+    });
+
+    buffer.reserve(binary.size());
+    benchmark("toBinary(QByteArray) reused buffer", 1000, [&]() {
+        buffer.resize(0);
+        message.toBinary(buffer);
+    });
+}
+
+void benchmarkPackedArrays() {
+    printf("\n== Value packed arrays ==\n");
+
+    // point cloud sized float array, as decoded from a rosbridge message
+    const int n = 100000;
+    Value::FloatArray floats(n);
+    Value::Array array;
+    array.reserve(n);
+    for (int i = 0; i < n; i++) {
+        floats[i] = i * 0.001;
+        array.append(Value(i * 0.001));
+    }
+    Value packed = floats;
+    Value plain = array;
+
+    benchmark("copy + modify plain", 100, [&]() {
+        Value v = plain;
+        v[0] = 42.0;
+    });
+
+    benchmark("copy + modify packed (unpacks)", 100, [&]() {
+        Value v = packed;
+        v[0] = 42.0;
+    });
+
+    benchmark("sum plain", 100, [&]() {
+        volatile double sum = 0.0;
+        const Value::Array& a = plain.getArrayRef();
+        for (int i = 0; i < a.size(); i++) {
+            sum += a.at(i).getFloat();
+        }
+    });
+
+    benchmark("sum packed", 100, [&]() {
+        volatile double sum = 0.0;
+        const Value::FloatArray& a = packed.getFloatArrayRef();
+        for (int i = 0; i < a.size(); i++) {
+            sum += a.at(i);
+        }
+    });
+
+    QByteArray json;
+    packed.toJson(json);
+    printf("array size: %d bytes\n", json.size());
+
+    benchmark("fromJson packed", 100, [&]() {
+        Value v;
+        v.fromJson(json.constData(), json.size());
+    });
+
+    QByteArray buffer;
+    buffer.reserve(json.size());
+    benchmark("toJson plain", 100, [&]() {
+        buffer.resize(0);
+        plain.toJson(buffer);
+    });
+
+    benchmark("toJson packed", 100, [&]() {
+        buffer.resize(0);
+        packed.toJson(buffer);
+    });
+}
+
+void benchmarkUnite() {
+    printf("\n== Value unite ==\n");
+
+    // invocation output of an application which only changes a few fields between invocations
+    Value output = createNested(4, 8);
+    Value unchanged = createNested(4, 8);
+    Value changed = createNested(4, 8);
+    changed["key0"]["key1"]["key2"]["key3"][0] = 42;
+    changed["key7"]["key0"]["key5"]["key1"][7] = 42;
+    changed["key3"]["key3"]["key3"]["key3"][8] = 42;
+
+    QList<ValuePath> changes;
+    benchmark("unite nested, 0 changes", 100, [&]() {
+        Value v = output;
+        v.unite(unchanged);
+    });
+
+    benchmark("unite nested, 3 changes", 100, [&]() {
+        Value v = output;
+        v.unite(changed);
+    });
+
+    benchmark("unite nested, 3 changes + change list", 100, [&]() {
+        Value v = output;
+        changes.clear();
+        v.unite(changed, &changes);
+    });
+
+    // what consumers had to do before to find out what changed
+    benchmark("unite nested + toJson", 10, [&]() {
+        Value v = output;
+        v.unite(changed);
+        QString json;
+        v.toJson(json);
+    });
+}
+
+void benchmarkSnapshots() {
+    printf("\n== Value snapshots ==\n");
+
+    // equal, but separately decoded messages share no payloads
+    Value a = createNested(4, 8);
+    Value b = createNested(4, 8);
+
+    benchmark("== nested", 100, [&]() {
+        bool equal = a == b;
+        (void) equal;
+    });
+
+    benchmark("snapshot nested", 100, [&]() {
+        ValueSnapshot snapshot = b;
+    });
+
+    ValueSnapshot sa = a;
+    ValueSnapshot sb = b;
+    benchmark("snapshot ==", 1000000, [&]() {
+        bool equal = sa == sb;
+        (void) equal;
+    });
+
+    QHash<ValueSnapshot, bool> cache;
+    cache[sa] = true;
+    benchmark("snapshot cache lookup", 1000000, [&]() {
+        cache.value(sb);
+    });
+}
+
+void benchmarkXml() {
+    printf("\n== Value XML ==\n");
+
+    // SMDL document with 10k states, each with a small input
+    Value input;
+    input["topic"] = "/robot/goal";
+    input["timeout"] = 42;
+    input["pose"]["x"] = 0.5;
+    input["pose"]["y"] = -0.5;
+
+    pugi::xml_document doc;
+    pugi::xml_node root = doc.append_child("statemachine");
+    for (int i = 0; i < 10000; i++) {
+        pugi::xml_node node = root.append_child("invoke").append_child("input");
+        input.toXml(node);
+    }
+
+    // what the importer did before: print every node and parse it again
+    benchmark("import 10k inputs, print + parse", 10, [&]() {
+        for (pugi::xml_node state = root.first_child(); state; state = state.next_sibling()) {
+            std::ostringstream stream;
+            state.child("input").print(stream);
+            Value v;
+            v.fromXml(QString(stream.str().c_str()));
+        }
+    });
+
+    benchmark("import 10k inputs, from node", 10, [&]() {
+        for (pugi::xml_node state = root.first_child(); state; state = state.next_sibling()) {
+            Value v;
+            v.fromXml(state.child("input"));
+        }
+    });
+}
+
+long residentSetSize() {
+    long pages = 0;
+    FILE* statm = fopen("/proc/self/statm", "r");
+    if (statm != NULL) {
+        if (fscanf(statm, "%*ld %ld", &pages) != 1) {
+            pages = 0;
+        }
+        fclose(statm);
+    }
+
+    return pages * sysconf(_SC_PAGESIZE) / 1024;
+}
+
+void benchmarkScriptBinding() {
+    printf("\n== Value script binding ==\n");
+
+    // what ConditionalTransition::eventTest does for every event with a condition
+    QScriptEngine engine;
+    Value input;
+    input["goal"]["id"] = "goal1";
+    Value output;
+    output["result"] = 42;
+    QString condition = "input.goal.id == 'goal1' && output.result > 0";
+
+    auto evaluate = [&]() {
+        QScriptContext* context = engine.pushContext();
+        context->activationObject().setProperty("input", ValueScriptBinding::create(&engine, &input));
+        context->activationObject().setProperty("output", ValueScriptBinding::create(&engine, &output));
+        engine.evaluate(condition).toBool();
+        engine.popContext();
+    };
+
+    benchmark("evaluate condition", 100000, evaluate);
+
+    // soak: resident memory has to stay flat, bindings used to be leaked on every evaluation
+    long before = residentSetSize();
+    for (int i = 0; i < 1000000; i++) {
+        evaluate();
+    }
+    engine.collectGarbage();
+    long after = residentSetSize();
+    printf("%-40s %12ld kB -> %ld kB\n", "rss after 1M conditional events", before, after);
+}
+
+void benchmarkConditions() {
+    printf("\n== Value conditions ==\n");
+
+    // conditional transitions listening on the same event, each one tests its condition against the source state
+    QScriptEngine engine;
+    Value input;
+    input["goal"]["id"] = "goal1";
+    Value output;
+    output["result"] = 42;
+
+    int counts[] = {1, 10, 100};
+    for (int c = 0; c < 3; c++) {
+        QList<QString> conditions;
+        QList<QScriptProgram> programs;
+        for (int i = 0; i < counts[c]; i++) {
+            conditions.append(QString("input.goal.id == 'goal1' && output.result > %1").arg(i));
+            programs.append(QScriptProgram(conditions.last()));
+        }
+
+        QByteArray name = QString("1 event, %1 conditions, evaluate string").arg(counts[c]).toUtf8();
+        benchmark(name.constData(), 10000 / counts[c], [&]() {
+            for (int i = 0; i < conditions.size(); i++) {
+                QScriptContext* context = engine.pushContext();
+                context->activationObject().setProperty("input", ValueScriptBinding::create(&engine, &input));
+                context->activationObject().setProperty("output", ValueScriptBinding::create(&engine, &output));
+                engine.evaluate(conditions[i]).toBool();
+                engine.popContext();
+            }
+        });
+
+        name = QString("1 event, %1 conditions, evaluate program").arg(counts[c]).toUtf8();
+        benchmark(name.constData(), 10000 / counts[c], [&]() {
+            for (int i = 0; i < programs.size(); i++) {
+                QScriptContext* context = engine.pushContext();
+                context->activationObject().setProperty("input", ValueScriptBinding::create(&engine, &input));
+                context->activationObject().setProperty("output", ValueScriptBinding::create(&engine, &output));
+                engine.evaluate(programs[i]).toBool();
+                engine.popContext();
+            }
+        });
+
+        QList<Expression> expressions;
+        for (int i = 0; i < conditions.size(); i++) {
+            expressions.append(Expression());
+            expressions.last().compile(conditions[i]);
+        }
+
+        name = QString("1 event, %1 conditions, native").arg(counts[c]).toUtf8();
+        benchmark(name.constData(), 1000000 / counts[c], [&]() {
+            bool result;
+            for (int i = 0; i < expressions.size(); i++) {
+                expressions[i].evaluate(input, output, result);
+            }
+        });
+    }
+}
+
+void benchmarkTransformations() {
+    printf("\n== Value transformations ==\n");
+
+    // a dataflow converting the output of one state into the input of the next
+    QScriptEngine engine;
+    Value input;
+    Value output;
+    output["velocity"] = 1500.0;
+    Value result;
+
+    QString transformation = "output.velocity * 0.001";
+    QScriptProgram program(transformation);
+    benchmark("unit conversion, evaluate program", 10000, [&]() {
+        QScriptContext* context = engine.pushContext();
+        context->activationObject().setProperty("input", ValueScriptBinding::create(&engine, &input));
+        context->activationObject().setProperty("output", ValueScriptBinding::create(&engine, &output));
+        result = engine.evaluate(program).toNumber();
+        engine.popContext();
+    });
+
+    Expression expression;
+    expression.compile(transformation);
+    benchmark("unit conversion, native", 1000000, [&]() {
+        expression.evaluate(input, output, result);
+    });
+
+    // unchanged inputs are detected by comparing the values the expression reads
+    const Value& source = output;
+    ValueKey key("velocity");
+    Value argument = source[key];
+    benchmark("unit conversion, unchanged input", 1000000, [&]() {
+        if (source[key] != argument) {
+            expression.evaluate(input, output, result);
+        }
+    });
+}
+
+/*
+ * main
+ */
+int main(int argc, char** argv) {
+    benchmarkConstruction();
+    benchmarkCopyOnWrite();
+    benchmarkPath();
+    benchmarkKeys();
+    benchmarkJson();
+    benchmarkPackedArrays();
+    benchmarkUnite();
+    benchmarkSnapshots();
+    benchmarkXml();
+    benchmarkScriptBinding();
+    benchmarkConditions();
+    benchmarkTransformations();
+
+    return 0;
+}
@@ -27,6 +27,8 @@
 #include <QRegExp>
 
 namespace hfsmexec {
+    class NamedEvent;
+
     class Api {
       public:
         Api();
@@ -52,6 +54,7 @@ namespace hfsmexec {
 
         PushNotification logPushNotification;
         PushNotification statePushNotification;
+        PushNotification stateBinaryPushNotification;
 
         void log(HttpRequest* request, HttpResponse* response);
         void statemachineState(HttpRequest* request, HttpResponse* response);
@@ -60,6 +63,10 @@ namespace hfsmexec {
         void statemachineStart(HttpRequest* request, HttpResponse* response);
         void statemachineStop(HttpRequest* request, HttpResponse* response);
         void statemachineEvent(HttpRequest* request, HttpResponse* response);
+        void statemachineEvents(HttpRequest* request, HttpResponse* response);
+
+        static bool setEvent(const ValueView& value, NamedEvent* event);
+        static bool isBinary(const std::string& mediaType);
 
         void assign(QString pattern, QString method, std::function<void(HttpRequest*, HttpResponse*)> handler);
         void httpHandler(HttpRequest* request, HttpResponse* response);
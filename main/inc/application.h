@@ -47,6 +47,7 @@ namespace hfsmexec {
         QString exportStateMachine;
         QString importEncoding;
         QString exportEncoding;
+        bool nativeEngine;
 
         void load();
     };
@@ -70,6 +71,7 @@ namespace hfsmexec {
 
       public slots:
         bool postEvent(AbstractEvent* event);
+        bool postEvents(const QList<AbstractEvent*>& events);
 
         bool loadStateMachine(const QString& encoding, const QString& data);
         bool unloadStateMachine();
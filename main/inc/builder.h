@@ -6,6 +6,8 @@
 #include <logger.h>
 #include <statemachine.h>
 
+#include <QHash>
+
 namespace hfsmexec {
     class StateMachineBuilder {
       public:
@@ -30,6 +32,7 @@ namespace hfsmexec {
         QList<AbstractState*> states;
         QList<AbstractTransition*> transitions;
         QList<Dataflow*> dataflows;
+        QHash<QString, AbstractState*> stateIds;
 
         AbstractState* getState(const QString& stateId);
     };
@@ -0,0 +1,118 @@
+/*
+ *  Copyright (C) 2014 Marcel Lehwald
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include <logger.h>
+#include <eventqueue.h>
+#include <statemachine.h>
+#include <topology.h>
+
+#include <QHash>
+#include <QAtomicInt>
+#include <QList>
+#include <QMutex>
+#include <QObject>
+#include <QVector>
+
+namespace hfsmexec {
+    /*
+     * Executes a built state machine without QStateMachine. The hierarchy is taken from the topology of the state
+     * machine: every transition knows its domain and the ordered list of states it enters, everything active within
+     * the domain is exited. Events are processed in run-to-completion steps, named events only test the transitions
+     * indexed for their id. Posted events go through a lock-free queue, the machine thread is woken up once and
+     * drains them in batches.
+     */
+    class StateMachineEngine : public QObject {
+        Q_OBJECT
+
+      public:
+        StateMachineEngine(StateMachine* stateMachine);
+        ~StateMachineEngine();
+
+        bool compile();
+
+        void start();
+        void stop();
+        bool isRunning();
+
+        bool postEvent(AbstractEvent* event, bool highPriority = false);
+        bool postEvents(const QList<AbstractEvent*>& events, bool highPriority = false);
+        int postDelayedEvent(AbstractEvent* event, int delay);
+
+        bool isActive(const AbstractState* state) const;
+        qint64 getTransitionCount() const;
+
+      protected:
+        virtual void timerEvent(QTimerEvent* event);
+
+      private slots:
+        void process();
+        void startDelayedEvent(int id, int delay);
+
+      private:
+        static const Logger* logger;
+        StateMachine* stateMachine;
+        const StateMachineTopology* topology;
+        bool compiled;
+
+        // complex states and the transitions to test, indexed like the topology
+        QVector<AbstractComplexState*> complexStates;
+        QHash<int, QVector<int> > eventTransitions;
+        QVector<int> otherTransitions;
+        QHash<int, int> invokeDoneEvents;
+
+        // configuration, other threads only see the copy published by the machine thread
+        QVector<bool> active;
+        QVector<bool> completed;
+        QVector<bool> published;
+        bool changed;
+        qint64 transitionCount;
+
+        // events are posted from any thread without locking, the mutex guards everything else
+        EventQueue queue;
+        QVector<AbstractEvent*> batch;
+        QAtomicInt running;
+        QAtomicInt scheduled;
+        mutable QMutex mutex;
+        QList<AbstractEvent*> priorityQueue;
+        QList<AbstractEvent*> overflowQueue;
+        QHash<int, AbstractEvent*> delayedEvents;
+        QHash<int, int> delayedTimers;
+        int nextDelayedEvent;
+        bool pendingStart;
+        bool pendingStop;
+
+        // scratch space of a step
+        QVector<int> selected;
+        QVector<int> exitSet;
+        QVector<int> entrySet;
+
+        void schedule();
+        void publish();
+        void enterInitial();
+        void halt();
+        void step(AbstractEvent* event);
+        void execute(AbstractEvent* event);
+        void enter(const QVector<int>& set);
+        void complete(int state);
+        void completeParent(int state);
+    };
+}
+
+#endif
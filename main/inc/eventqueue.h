@@ -0,0 +1,63 @@
+/*
+ *  Copyright (C) 2014 Marcel Lehwald
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef EVENTQUEUE_H
+#define EVENTQUEUE_H
+
+#include <QAtomicInt>
+#include <QList>
+
+namespace hfsmexec {
+    class AbstractEvent;
+
+    /*
+     * Bounded lock-free queue of events with any number of producers and a single consumer. The slots are allocated
+     * once, every slot carries a sequence number telling whether it is free for the producer of a position or filled
+     * for the consumer. Positions are unsigned counters kept in atomic ints, they are compared by their difference
+     * and may wrap around. Producers only compete for the enqueue position, the consumer never blocks them. A list of events
+     * claims consecutive positions at once, so it is dequeued without events of other producers in between.
+     */
+    class EventQueue {
+      public:
+        EventQueue(int capacity);
+        ~EventQueue();
+
+        int getCapacity() const;
+
+        bool enqueue(AbstractEvent* event);
+        bool enqueue(const QList<AbstractEvent*>& events);
+        AbstractEvent* dequeue();
+        int dequeue(AbstractEvent** events, int count);
+
+      private:
+        typedef struct {
+            QAtomicInt sequence;
+            AbstractEvent* event;
+        } Slot;
+
+        Slot* slots;
+        quint32 mask;
+        QAtomicInt enqueuePosition;
+        quint32 dequeuePosition;
+
+        EventQueue(const EventQueue& other);
+        EventQueue& operator=(const EventQueue& other);
+    };
+}
+
+#endif
@@ -0,0 +1,127 @@
+/*
+ *  Copyright (C) 2014 Marcel Lehwald
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef EXPRESSION_H
+#define EXPRESSION_H
+
+#include <value.h>
+
+#include <QList>
+#include <QString>
+#include <QVector>
+
+namespace hfsmexec {
+    /*
+     * Transition conditions are mostly comparisons on the input and output of a state, like
+     * "output.status == 3 && input.retries < 5". An Expression compiles such a condition into a small stack based
+     * bytecode, which is evaluated directly over the values with the semantics the condition would have in QtScript.
+     * Literals, paths into input, output and the payload of the tested event, arithmetic, comparisons, boolean logic
+     * and ?: are supported. Everything else fails to compile and has to be left to QtScript, as do the few cases which
+     * can only be decided at runtime (e.g. comparing arrays or objects), for which evaluate() returns false.
+     *
+     * The same expressions are used to transform values in dataflows, where the result itself is needed instead of
+     * its truth value. getPaths() lists everything an expression reads, so that callers can tell whether a result is
+     * still up to date.
+     */
+    class Expression {
+      public:
+        Expression();
+        ~Expression();
+
+        bool compile(const QString& expression);
+        bool evaluate(const Value& input, const Value& output, bool& result) const;
+        bool evaluate(const Value& input, const Value& output, Value& result) const;
+        bool evaluate(const Value& input, const Value& output, const Value& event, bool& result) const;
+        bool evaluate(const Value& input, const Value& output, const Value& event, Value& result) const;
+
+        QList<ValuePath> getPaths() const;
+
+        bool isValid() const;
+        const QString& getError() const;
+
+      private:
+        typedef enum {
+            OP_PUSH = 0,
+            OP_INPUT,
+            OP_OUTPUT,
+            OP_EVENT,
+            OP_KEY,
+            OP_INDEX,
+            OP_NOT,
+            OP_NEGATE,
+            OP_PLUS,
+            OP_ADD,
+            OP_SUBTRACT,
+            OP_MULTIPLY,
+            OP_DIVIDE,
+            OP_MODULO,
+            OP_EQUAL,
+            OP_NOT_EQUAL,
+            OP_STRICT_EQUAL,
+            OP_STRICT_NOT_EQUAL,
+            OP_LESS,
+            OP_LESS_EQUAL,
+            OP_GREATER,
+            OP_GREATER_EQUAL,
+            OP_AND,
+            OP_OR,
+            OP_JUMP,
+            OP_JUMP_IF_FALSE
+        } OpCode;
+
+        typedef struct {
+            OpCode op;
+            int arg;
+        } Instruction;
+
+        typedef enum {
+            TOKEN_END = 0,
+            TOKEN_NUMBER,
+            TOKEN_STRING,
+            TOKEN_IDENTIFIER,
+            TOKEN_PUNCTUATOR,
+            TOKEN_INVALID
+        } TokenType;
+
+        QVector<Instruction> program;
+        QVector<Value> constants;
+        QVector<ValueKey> keys;
+        int maxDepth;
+        bool valid;
+        QString error;
+
+        // compiler state
+        QString source;
+        int pos;
+        int depth;
+        TokenType token;
+        QString text;
+        double number;
+
+        void next();
+        int write(OpCode op, int arg = 0);
+        bool fail(const QString& message);
+
+        bool parseConditional();
+        bool parseBinary(int precedence);
+        bool parseUnary();
+        bool parsePrimary();
+        bool parsePostfix();
+    };
+}
+
+#endif
@@ -20,9 +20,11 @@
 
 #include <microhttpd.h>
 #include <map>
+#include <vector>
 #include <sstream>
 #include <mutex>
 #include <condition_variable>
+#include <chrono>
 
 namespace hfsmexec {
     class PushNotification {
@@ -32,14 +34,18 @@ namespace hfsmexec {
 
         void write(const std::string& data);
         bool read(int& pos, std::string& data, int timeout = 5);
+        bool read(int& pos, std::vector<std::string>& data, int timeout = 5);
 
         void unlock();
+        bool isSubscribed();
 
       private:
         std::map<int, std::string> buffer;
         int pos;
         int maxQueueSize;
         int maxReadSize;
+        int readers;
+        std::chrono::steady_clock::time_point lastRead;
         std::mutex lock;
         std::condition_variable condition;
     };
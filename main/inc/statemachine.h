@@ -22,18 +22,25 @@
 
 #include <logger.h>
 #include <value.h>
+#include <expression.h>
 
 #include <QEvent>
 #include <QAbstractTransition>
 #include <QFinalState>
+#include <QHash>
+#include <QMutex>
+#include <QPair>
 #include <QState>
 #include <QStateMachine>
+#include <QScriptProgram>
 
 class QScriptEngine;
 
 namespace hfsmexec {
     class AbstractState;
     class StateMachine;
+    class StateMachineEngine;
+    class StateMachineTopology;
     class CommunicationPlugin;
 
     class AbstractEvent : public QEvent {
@@ -42,12 +49,17 @@ namespace hfsmexec {
 
         virtual QString toString() const = 0;
 
+        static int internEventName(const QString& eventName);
+        static int findEventName(const QString& eventName);
+        static QString lookupEventName(int eventId);
+
       protected:
         static const Logger* logger;
     };
 
     class AbstractTransition : public QAbstractTransition {
         friend class StateMachineBuilder;
+        friend class StateMachineEngine;
 
       public:
         AbstractTransition(const QString transitionId, const QString sourceStateId, const QString targetStateId);
@@ -76,19 +88,40 @@ namespace hfsmexec {
     };
 
     class Assign {
+        friend class StateMachineBuilder;
+
       public:
         Assign(const QString& from, const QString& to);
         ~Assign();
 
         const QString& getFrom() const;
         const QString& getTo() const;
+        const ValuePath& getFromPath() const;
+        const ValuePath& getToPath() const;
+
+        bool isTransformation() const;
+        bool evaluate(AbstractState* sourceState, Value& event, Value& result);
+
+        bool initialize();
 
         QString toString() const;
 
       private:
+        static const Logger* logger;
         QString from;
         QString to;
+        ValuePath fromPath;
+        ValuePath toPath;
         StateMachine* stateMachine;
+
+        // transformations, "from" is an expression instead of a path
+        bool transformation;
+        Expression expression;
+        QScriptProgram program;
+        QList<ValuePath> dependencies;
+        QVector<Value> arguments;
+        Value result;
+        bool evaluated;
     };
 
     class Dataflow {
@@ -108,6 +141,8 @@ namespace hfsmexec {
         AbstractState* getTargetState();
         StateMachine* getStateMachine();
 
+        void apply();
+
         QString toString() const;
 
       private:
@@ -172,6 +207,8 @@ namespace hfsmexec {
     class AbstractComplexState : public AbstractState {
         Q_OBJECT
 
+        friend class StateMachineEngine;
+
       public:
         AbstractComplexState(const QString& stateId, const QString& parentStateId = "");
         virtual ~AbstractComplexState();
@@ -192,6 +229,7 @@ namespace hfsmexec {
       protected:
         QState* delegate;
         bool active;
+        int finishEventId;
     };
 
     class NamedEvent : public AbstractEvent {
@@ -199,8 +237,10 @@ namespace hfsmexec {
         static const QEvent::Type type;
 
         NamedEvent(const QString& eventName);
+        NamedEvent(int eventId);
         ~NamedEvent();
 
+        int getEventId() const;
         const QString& getEventName() const;
         void setEventName(const QString& eventName);
 
@@ -210,18 +250,27 @@ namespace hfsmexec {
         const QString& getMessage() const;
         void setMessage(const QString& message);
 
+        Value& getPayload();
+        const Value& getPayload() const;
+        void setPayload(const Value& payload);
+
         virtual QString toString() const;
 
       private:
+        int eventId;
         QString eventName;
         QString origin;
         QString message;
+        Value payload;
     };
 
     class ConditionalTransition : public AbstractTransition {
       public:
         ConditionalTransition(const QString& transitionId, const QString& sourceStateId, const QString& targetStateId, const QString& eventName, QString condition = "");
 
+        int getEventId() const;
+        const QString& getEventName() const;
+
         virtual bool initialize();
 
         virtual QString toString() const;
@@ -231,8 +280,12 @@ namespace hfsmexec {
         virtual void onTransition(QEvent* e);
 
       private:
+        int eventId;
         QString eventName;
         QString condition;
+        Expression expression;
+        QScriptProgram program;
+        Value eventPayload;
     };
 
     class InternalEvent : public AbstractEvent {
@@ -240,13 +293,16 @@ namespace hfsmexec {
         static const QEvent::Type type;
 
         InternalEvent(const QString& eventName);
+        InternalEvent(int eventId);
         ~InternalEvent();
 
+        int getEventId() const;
         const QString& getEventName() const;
 
         virtual QString toString() const;
 
       private:
+        int eventId;
         QString eventName;
     };
 
@@ -259,7 +315,7 @@ namespace hfsmexec {
         virtual void onTransition(QEvent* e);
 
       private:
-        QString eventName;
+        int eventId;
     };
 
     class FinalState : public AbstractState {
@@ -306,6 +362,8 @@ namespace hfsmexec {
     class InvokeState : public AbstractComplexState {
         Q_OBJECT
 
+        friend class StateMachineEngine;
+
       public:
         InvokeState(const QString& stateId, const QString& binding, const QString& parentStateId = "");
         virtual ~InvokeState();
@@ -334,6 +392,9 @@ namespace hfsmexec {
         CommunicationPlugin* communicationPlugin;
         Value endpoint;
         bool invocationActive;
+        int successEventId;
+        int errorEventId;
+        int doneEventId;
 
         void success(const Value& output);
         void error(QString message = "");
@@ -343,6 +404,7 @@ namespace hfsmexec {
         Q_OBJECT
 
         friend class StateMachineBuilder;
+        friend class ConditionalTransition;
 
       public:
         StateMachine(const QString& stateId, const QString& initialId, const QString& parentStateId = "");
@@ -352,12 +414,30 @@ namespace hfsmexec {
 
         void start() const;
         void stop() const;
+        bool isRunning() const;
+
+        void setNativeEngine(bool enabled);
+        StateMachineEngine* getEngine();
+
+        const StateMachineTopology* getTopology() const;
+
+        using AbstractState::getChildState;
+        using AbstractState::getTransition;
+        AbstractState* getState(const QString& stateId) const;
+        AbstractState* getChildState(const AbstractState* parentState, const QString& stateId) const;
+        AbstractTransition* getTransition(const AbstractState* sourceState, const QString& transitionId) const;
 
         int postDelayedEvent(AbstractEvent* event, int delay);
-        void postEvent(AbstractEvent* event, QStateMachine::EventPriority priority = QStateMachine::NormalPriority);
+        bool postEvent(AbstractEvent* event, QStateMachine::EventPriority priority = QStateMachine::NormalPriority);
+        bool postEvents(const QList<AbstractEvent*>& events, QStateMachine::EventPriority priority = QStateMachine::NormalPriority);
 
         QScriptEngine* getScriptEngine();
 
+        const QList<ConditionalTransition*> getEventTransitions(int eventId) const;
+
+        Value& getEventPayload();
+        void setEventPayload(const Value& payload);
+
         virtual QStateMachine* getDelegate() const;
         virtual bool initialize();
         virtual QString toString() const;
@@ -370,9 +450,19 @@ namespace hfsmexec {
       protected:
         QStateMachine* delegate;
         QScriptEngine* scriptEngine;
+        StateMachineEngine* engine;
+        StateMachineTopology* topology;
 
       private:
+        QMutex postMutex;
+        Value eventPayload;
         QString initialId;
+        QHash<int, QList<ConditionalTransition*> > eventTransitions;
+
+        // id lookups, maintained by the builder
+        QHash<QString, AbstractState*> stateIds;
+        QHash<QPair<const AbstractState*, QString>, AbstractState*> childStateIds;
+        QHash<QPair<const AbstractState*, QString>, AbstractTransition*> transitionIds;
     };
 }
 
@@ -0,0 +1,132 @@
+/*
+ *  Copyright (C) 2014 Marcel Lehwald
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+
+#include <logger.h>
+#include <statemachine.h>
+
+#include <QHash>
+#include <QMultiHash>
+#include <QString>
+#include <QVector>
+
+namespace hfsmexec {
+    /*
+     * The hierarchy of a built state machine as flat arrays. States are numbered in document order, so the descendants
+     * of a state are the indices up to its subtree end, and every state knows its parent and depth. For each
+     * transition the domain (the nearest compound state properly containing source and target) and the ordered list
+     * of states it enters are computed once, the states it exits are the active ones within the domain. Lookups walk
+     * these arrays instead of the QObject tree.
+     */
+    class StateMachineTopology {
+      public:
+        typedef enum {
+            KIND_ATOMIC = 0,
+            KIND_COMPOUND,
+            KIND_PARALLEL,
+            KIND_FINAL,
+            KIND_INVOKE
+        } Kind;
+
+        typedef struct {
+            AbstractTransition* transition;
+            int source;
+            int target;
+            int domain;
+            int entryOffset;
+            int entryCount;
+        } Transition;
+
+        StateMachineTopology();
+        ~StateMachineTopology();
+
+        bool addStates(StateMachine* stateMachine);
+        bool addTransitions();
+
+        inline int size() const {
+            return states.size();
+        }
+
+        inline AbstractState* getState(int state) const {
+            return states[state];
+        }
+
+        inline Kind getKind(int state) const {
+            return kinds[state];
+        }
+
+        inline int getParent(int state) const {
+            return parents[state];
+        }
+
+        inline int getDepth(int state) const {
+            return depths[state];
+        }
+
+        inline int getEnd(int state) const {
+            return ends[state];
+        }
+
+        inline int getInitial(int state) const {
+            return initials[state];
+        }
+
+        inline bool contains(int state, int descendant) const {
+            return descendant >= state && descendant < ends[state];
+        }
+
+        int indexOf(const AbstractState* state) const;
+        int getLca(int a, int b) const;
+        AbstractState* findState(const AbstractState* ancestor, const QString& stateId) const;
+
+        inline const QVector<Transition>& getTransitions() const {
+            return transitions;
+        }
+
+        inline const int* getEntries(const Transition& transition) const {
+            return entries.constData() + transition.entryOffset;
+        }
+
+        inline const QVector<int>& getInitialEntries() const {
+            return initialEntries;
+        }
+
+      private:
+        static const Logger* logger;
+
+        QVector<AbstractState*> states;
+        QVector<Kind> kinds;
+        QVector<int> parents;
+        QVector<int> depths;
+        QVector<int> ends;
+        QVector<int> initials;
+        QHash<const AbstractState*, int> indices;
+        QMultiHash<QString, int> ids;
+
+        QVector<Transition> transitions;
+        QVector<int> entries;
+        QVector<int> initialEntries;
+
+        void add(AbstractState* state, int parent);
+        void addDescendants(int state, QVector<int>& set) const;
+        void addAncestors(int state, int ancestor, QVector<int>& set) const;
+    };
+}
+
+#endif
@@ -22,23 +22,27 @@
 
 #include <logger.h>
 
-#include <QObject>
 #include <QString>
+#include <QByteArray>
+#include <QList>
+#include <QVector>
+#include <QHash>
+#include <QAtomicInt>
+#include <QAtomicPointer>
 #include <QMutex>
+#include <QSharedData>
+#include <QObject>
 #include <QScriptEngine>
 #include <QScriptClass>
 
 #include <exception>
-#include <memory>
+
+class QReadWriteLock;
 
 namespace pugi {
     class xml_node;
 }
 
-namespace Json {
-    class Value;
-}
-
 namespace YAML {
     class Node;
 }
@@ -46,11 +50,57 @@ namespace YAML {
 namespace hfsmexec {
     class ArbitraryValue;
     class NullValue;
+    class ValuePath;
+
+    class ValueKey {
+      public:
+        ValueKey();
+        ValueKey(const QString& key);
+        ValueKey(const char* key);
+        ValueKey(const ValueKey& other);
+        ~ValueKey();
+
+        ValueKey& operator=(const ValueKey& other);
+
+        static int getAtomCount();
+
+        inline const QString& toString() const {
+            return atom->key;
+        }
+
+        inline bool operator==(const ValueKey& other) const {
+            return atom == other.atom;
+        }
+
+        inline bool operator!=(const ValueKey& other) const {
+            return atom != other.atom;
+        }
+
+        inline bool operator<(const ValueKey& other) const {
+            return atom < other.atom;
+        }
+
+      private:
+        struct Atom {
+            QString key;
+            QAtomicInt references;
+        };
+
+        Atom* atom;
 
-    class Value : public QObject {
-        Q_OBJECT
+        static QHash<QString, Atom*>& getAtoms();
+        static QReadWriteLock& getLock();
+        static Atom* intern(const QString& key);
+        static void release(Atom* atom);
+    };
+}
+
+Q_DECLARE_TYPEINFO(hfsmexec::ValueKey, Q_MOVABLE_TYPE);
+
+namespace hfsmexec {
 
-        friend class Iterator;
+    class Value {
+        friend class ArbitraryValue;
 
       public:
         typedef enum {
@@ -64,14 +114,7 @@ namespace hfsmexec {
             TYPE_OBJECT
         } Type;
 
-        const char* typeNames[8] = {"Undefined",
-                                    "Null",
-                                    "Boolean",
-                                    "Integer",
-                                    "Float",
-                                    "String",
-                                    "Array",
-                                    "Object"};
+        static const char* typeNames[8];
 
         struct Undefined {};
         struct Null {};
@@ -87,11 +130,230 @@ namespace hfsmexec {
         typedef QString StringQt;
         typedef StringQt String;
         typedef QList<Value> Array;
-        typedef QMap<String, Value> Object;
+        typedef QVector<Integer> IntegerArray;
+        typedef QVector<Float> FloatArray;
+
+        class Object {
+            friend class ArbitraryValue;
+
+          public:
+            class iterator {
+              public:
+                inline iterator() :
+                    object(NULL),
+                    i(0) {
+                }
+
+                inline iterator(Object* object, int i) :
+                    object(object),
+                    i(i) {
+                }
+
+                inline const String& key() const {
+                    return object->keys[i].toString();
+                }
+
+                inline const ValueKey& atom() const {
+                    return object->keys[i];
+                }
+
+                inline Value& value() const {
+                    return object->values[i];
+                }
+
+                inline Value& operator*() const {
+                    return object->values[i];
+                }
+
+                inline Value* operator->() const {
+                    return &object->values[i];
+                }
+
+                inline iterator& operator++() {
+                    ++i;
+                    return *this;
+                }
+
+                inline iterator operator++(int) {
+                    iterator r = *this;
+                    ++i;
+                    return r;
+                }
+
+                inline iterator& operator+=(int j) {
+                    i += j;
+                    return *this;
+                }
+
+                inline iterator& operator--() {
+                    --i;
+                    return *this;
+                }
+
+                inline iterator operator--(int) {
+                    iterator r = *this;
+                    --i;
+                    return r;
+                }
+
+                inline iterator& operator-=(int j) {
+                    i -= j;
+                    return *this;
+                }
+
+                inline bool operator==(const iterator& other) const {
+                    return i == other.i && object == other.object;
+                }
+
+                inline bool operator!=(const iterator& other) const {
+                    return !(*this == other);
+                }
+
+              private:
+                Object* object;
+                int i;
+            };
+
+            class const_iterator {
+              public:
+                inline const_iterator() :
+                    object(NULL),
+                    i(0) {
+                }
+
+                inline const_iterator(const Object* object, int i) :
+                    object(object),
+                    i(i) {
+                }
+
+                inline const String& key() const {
+                    return object->keys[i].toString();
+                }
+
+                inline const ValueKey& atom() const {
+                    return object->keys[i];
+                }
+
+                inline const Value& value() const {
+                    return object->values[i];
+                }
+
+                inline const Value& operator*() const {
+                    return object->values[i];
+                }
+
+                inline const Value* operator->() const {
+                    return &object->values[i];
+                }
+
+                inline const_iterator& operator++() {
+                    ++i;
+                    return *this;
+                }
+
+                inline const_iterator operator++(int) {
+                    const_iterator r = *this;
+                    ++i;
+                    return r;
+                }
+
+                inline const_iterator& operator+=(int j) {
+                    i += j;
+                    return *this;
+                }
+
+                inline const_iterator& operator--() {
+                    --i;
+                    return *this;
+                }
+
+                inline const_iterator operator--(int) {
+                    const_iterator r = *this;
+                    --i;
+                    return r;
+                }
+
+                inline const_iterator& operator-=(int j) {
+                    i -= j;
+                    return *this;
+                }
+
+                inline bool operator==(const const_iterator& other) const {
+                    return i == other.i && object == other.object;
+                }
+
+                inline bool operator!=(const const_iterator& other) const {
+                    return !(*this == other);
+                }
+
+              private:
+                const Object* object;
+                int i;
+            };
+
+            inline int size() const {
+                return keys.size();
+            }
+
+            inline bool isEmpty() const {
+                return keys.isEmpty();
+            }
+
+            inline bool contains(const ValueKey& key) const {
+                return indexOf(key) >= 0;
+            }
+
+            inline iterator begin() {
+                return iterator(this, 0);
+            }
+
+            inline iterator end() {
+                return iterator(this, keys.size());
+            }
+
+            inline const_iterator begin() const {
+                return const_iterator(this, 0);
+            }
+
+            inline const_iterator end() const {
+                return const_iterator(this, keys.size());
+            }
+
+            inline const_iterator constBegin() const {
+                return const_iterator(this, 0);
+            }
+
+            inline const_iterator constEnd() const {
+                return const_iterator(this, keys.size());
+            }
+
+            iterator find(const ValueKey& key);
+            const_iterator find(const ValueKey& key) const;
+            iterator insert(const ValueKey& key, const Value& value);
+            int remove(const ValueKey& key);
+            void clear();
+
+            Value& operator[](const ValueKey& key);
+
+            bool operator==(const Object& other) const;
+            bool operator!=(const Object& other) const;
+
+            bool isDetached() const;
+            void detach();
+
+          private:
+            // keys are sorted by atom, so lookups are a binary search over pointers. The values are kept in a QList,
+            // which stores them in separate nodes, so references to values stay valid when other keys are inserted.
+            QVector<ValueKey> keys;
+            QList<Value> values;
+
+            int indexOf(const ValueKey& key) const;
+            int lowerBound(const ValueKey& key) const;
+        };
 
         class ArrayIterator {
           public:
-            ArrayIterator(const Value& value);
+            ArrayIterator(Value& value);
 
             inline int index() const {
                 return it - array->begin();
@@ -154,7 +416,7 @@ namespace hfsmexec {
 
         class ObjectIterator {
           public:
-            ObjectIterator(const Value& value);
+            ObjectIterator(Value& value);
 
             inline String key() const {
                 return it.key();
@@ -208,13 +470,139 @@ namespace hfsmexec {
                 return &*it;
             }
 
-            Value& operator[](const String key);
+            Value& operator[](const ValueKey& key);
 
           private:
             Object* object;
             Object::iterator it;
         };
 
+        class ConstArrayIterator {
+          public:
+            ConstArrayIterator(const Value& value);
+
+            inline int index() const {
+                return it - array->begin();
+            }
+
+            inline const Value& value() const {
+                return *it;
+            }
+
+            inline operator bool() const {
+                return array != NULL && it != array->end();
+            }
+
+            inline ConstArrayIterator& operator++() {
+                ++it;
+                return *this;
+            }
+
+            inline ConstArrayIterator operator++(int) {
+                ConstArrayIterator r = *this;
+                ++it;
+                return r;
+            }
+
+            inline ConstArrayIterator& operator+=(int i) {
+                it += i;
+                return *this;
+            }
+
+            inline ConstArrayIterator& operator--() {
+                --it;
+                return *this;
+            }
+
+            inline ConstArrayIterator operator--(int) {
+                ConstArrayIterator r = *this;
+                --it;
+                return r;
+            }
+
+            inline ConstArrayIterator& operator-=(int i) {
+                it -= i;
+                return *this;
+            }
+
+            inline const Value& operator*() const {
+                return *it;
+            }
+
+            inline const Value* operator->() const {
+                return &*it;
+            }
+
+            const Value& operator[](int i) const;
+
+          private:
+            const Array* array;
+            Array::const_iterator it;
+        };
+
+        class ConstObjectIterator {
+          public:
+            ConstObjectIterator(const Value& value);
+
+            inline String key() const {
+                return it.key();
+            }
+
+            inline const Value& value() const {
+                return *it;
+            }
+
+            inline operator bool() const {
+                return object != NULL && it != object->end();
+            }
+
+            inline ConstObjectIterator& operator++() {
+                ++it;
+                return *this;
+            }
+
+            inline ConstObjectIterator operator++(int) {
+                ConstObjectIterator r = *this;
+                ++it;
+                return r;
+            }
+
+            inline ConstObjectIterator& operator+=(int i) {
+                it += i;
+                return *this;
+            }
+
+            inline ConstObjectIterator& operator--() {
+                --it;
+                return *this;
+            }
+
+            inline ConstObjectIterator operator--(int) {
+                ConstObjectIterator r = *this;
+                --it;
+                return r;
+            }
+
+            inline ConstObjectIterator& operator-=(int i) {
+                it -= i;
+                return *this;
+            }
+
+            inline const Value& operator*() const {
+                return *it;
+            }
+
+            inline const Value* operator->() const {
+                return &*it;
+            }
+
+            const Value& operator[](const ValueKey& key) const;
+
+          private:
+            const Object* object;
+            Object::const_iterator it;
+        };
+
         Value();
         Value(const Boolean& value);
         Value(const Integer32& value);
@@ -226,7 +614,15 @@ namespace hfsmexec {
         Value(const String& value);
         Value(const Array& value);
         Value(const Object& value);
+        Value(const IntegerArray& value);
+        Value(const FloatArray& value);
+        Value(String&& value);
+        Value(Array&& value);
+        Value(Object&& value);
+        Value(IntegerArray&& value);
+        Value(FloatArray&& value);
         Value(const Value& value);
+        Value(Value&& value);
         Value(Value* const & value);
         ~Value();
 
@@ -246,6 +642,12 @@ namespace hfsmexec {
         Array getArray(Array defaultValue = Array()) const;
         Object getObject(Object defaultValue = Object()) const;
 
+        const String& getStringRef() const;
+        const Array& getArrayRef() const;
+        const Object& getObjectRef() const;
+        const IntegerArray& getIntegerArrayRef() const;
+        const FloatArray& getFloatArrayRef() const;
+
         bool get(Boolean& value, Boolean defaultValue = false) const;
         bool get(Integer& value, Integer defaultValue = 0) const;
         bool get(Float& value, Float defaultValue = 0) const;
@@ -263,18 +665,30 @@ namespace hfsmexec {
         void set(const String& value);
         void set(const Array& value);
         void set(const Object& value);
+        void set(const IntegerArray& value);
+        void set(const FloatArray& value);
+        void set(String&& value);
+        void set(Array&& value);
+        void set(Object&& value);
+        void set(IntegerArray&& value);
+        void set(FloatArray&& value);
         void set(const Value& value);
+        void set(Value&& value);
         void set(Value* const & value);
 
         Value& getValue(const QString& path);
         const Value& getValue(const QString& path) const;
+        Value& getValue(const ValuePath& path);
+        const Value& getValue(const ValuePath& path) const;
 
-        void unite(const Value& value);
+        bool unite(const Value& value, QList<ValuePath>* changes = NULL);
+        void promote();
 
-        int size();
-        void remove(const QString& key);
+        int size() const;
+        Value at(int i) const;
+        void remove(const ValueKey& key);
         void remove(int i);
-        bool contains(const QString& key);
+        bool contains(const ValueKey& key) const;
 
         void undefined();
         void null();
@@ -282,15 +696,23 @@ namespace hfsmexec {
         bool isValid() const;
 
         const Type& getType() const;
+        Type getPackedType() const;
 
-        String toString();
+        String toString() const;
 
         bool toXml(QString& xml, bool pretty = false) const;
+        bool toXml(pugi::xml_node& xml) const;
         bool toJson(QString& json, bool pretty = false) const;
+        bool toJson(QByteArray& json, bool pretty = false) const;
+        bool toBinary(QByteArray& binary) const;
         bool toYaml(QString& yaml) const;
 
         bool fromXml(const QString& xml);
+        bool fromXml(const pugi::xml_node& xml);
         bool fromJson(const QString& json);
+        bool fromJson(const char* json, int size);
+        bool fromBinary(const QByteArray& binary);
+        bool fromBinary(const char* binary, int size);
         bool fromYaml(const QString& yaml);
 
         const Value& operator=(const Boolean& value);
@@ -303,33 +725,68 @@ namespace hfsmexec {
         const Value& operator=(const String& value);
         const Value& operator=(const Array& value);
         const Value& operator=(const Object& value);
+        const Value& operator=(const IntegerArray& value);
+        const Value& operator=(const FloatArray& value);
+        const Value& operator=(String&& value);
+        const Value& operator=(Array&& value);
+        const Value& operator=(Object&& value);
+        const Value& operator=(IntegerArray&& value);
+        const Value& operator=(FloatArray&& value);
         const Value& operator=(const Value& other);
+        const Value& operator=(Value&& other);
         const Value& operator=(const Value* other);
 
         bool operator==(const Value& other) const;
         bool operator!=(const Value& other) const;
 
-        Value& operator[](const QString& name);
-        const Value& operator[](const QString& name) const;
+        Value& operator[](const ValueKey& name);
+        const Value& operator[](const ValueKey& name) const;
         Value& operator[](int i);
         const Value& operator[](int i) const;
 
       private:
+        typedef union {
+            Boolean b;
+            Integer i;
+            Float f;
+            ArbitraryValue* p;
+        } Data;
+
         static const Logger* logger;
-        std::shared_ptr<ArbitraryValue> value;
+        Type type;
+        bool heap;
+        Data data;
 
         template <typename T>
         bool get(T& value) const;
 
         template <typename T>
         void set(const T& value);
+        template <typename T>
+        void emplace(T&& value);
+
+        template <typename T>
+        T& cast();
+        template <typename T>
+        const T& cast() const;
+
+        bool unite(const Value& value, ValuePath& path, QList<ValuePath>* changes);
+        template <typename T>
+        void uniteVector(QVector<T>& target, const QVector<T>& source, ValuePath& path, QList<ValuePath>* changes);
+        static bool uniteChanges(const Value& target, const Value& value);
+
+        bool isLinked() const;
+        void attach(ArbitraryValue* value);
+        void detach();
+        void release();
+        void take(Value& other);
+        void copy(const Value& other);
+        void share(const Value& other);
 
         bool buildToXml(const Value* value, pugi::xml_node* xmlValue) const;
-        bool buildToJson(const Value* value, Json::Value* jsonValue) const;
         bool buildToYaml(const Value* value, YAML::Node* yamlValue) const;
 
-        bool buildFromXml(Value* value, pugi::xml_node* xmlValue);
-        bool buildFromJson(Value* value, Json::Value* jsonValue);
+        bool buildFromXml(Value* value, const pugi::xml_node& xmlValue);
         bool buildFromYaml(Value* value, YAML::Node* yamlValue);
     };
 
@@ -337,7 +794,7 @@ namespace hfsmexec {
       public:
         static NullValue& ref();
 
-        const Value& operator[](const QString& name) const;
+        const Value& operator[](const ValueKey& name) const;
         const Value& operator[](int i) const;
 
       private:
@@ -349,6 +806,277 @@ namespace hfsmexec {
         bool get(T& value) const;
     };
 
+    class ValuePath {
+        friend class Value;
+
+      public:
+        typedef struct {
+            ValueKey key;
+            int index;
+        } Segment;
+
+        ValuePath();
+        ValuePath(const QString& path);
+
+        bool isValid() const;
+        bool isEmpty() const;
+        int size() const;
+
+        const Segment& operator[](int i) const;
+
+        const QString& toString() const;
+
+      private:
+        QString path;
+        QVector<Segment> segments;
+        bool valid;
+
+        ValuePath(const QVector<Segment>& segments);
+
+        void append(const QString& name);
+    };
+
+    class ValueJsonReader {
+      public:
+        ValueJsonReader(const char* json, int size);
+
+        bool read(Value& value);
+
+        const QString& getError() const;
+
+      private:
+        static const int maxDepth = 512;
+
+        const char* begin;
+        const char* pos;
+        const char* end;
+        int depth;
+        QString error;
+        std::string buffer;
+
+        bool readValue(Value& value);
+        bool readLiteral(const char* literal, int size);
+        bool readNumber(Value& value);
+        bool readNumber(Value::Integer& integer, Value::Float& f, bool& integral);
+        bool readString(QString& string);
+        bool readEscape();
+        bool readHex(const char* p, uint& code) const;
+        bool readArray(Value& value);
+        bool readObject(Value& value);
+        void skipWhitespace();
+        bool fail(const QString& message);
+    };
+
+    class ValueJsonWriter {
+      public:
+        ValueJsonWriter(QByteArray& json, bool pretty = false);
+
+        void write(const Value& value);
+
+      private:
+        QByteArray& json;
+        bool pretty;
+        int indent;
+
+        void writeValue(const Value& value);
+        void writeInteger(Value::Integer value);
+        void writeFloat(Value::Float value);
+        void writeString(const QString& string);
+        void writeNewline();
+    };
+
+    class ValueCborReader {
+      public:
+        ValueCborReader(const char* cbor, int size);
+
+        bool read(Value& value);
+
+        int getPosition() const;
+        bool isTruncated() const;
+        const QString& getError() const;
+
+      private:
+        static const int maxDepth = 512;
+
+        const unsigned char* begin;
+        const unsigned char* pos;
+        const unsigned char* end;
+        int depth;
+        bool truncated;
+        QString error;
+
+        bool readValue(Value& value);
+        bool readHead(int& major, int& info, quint64& argument);
+        bool readLength(quint64 length);
+        bool readTypedArray(Value& value, quint64 tag);
+        bool fail(const QString& message);
+        bool truncate();
+    };
+
+    class ValueCborWriter {
+      public:
+        ValueCborWriter(QByteArray& cbor);
+
+        void write(const Value& value);
+        void writeArray(int size);
+
+      private:
+        QByteArray& cbor;
+
+        void writeHead(int major, quint64 argument);
+        void writeInteger(Value::Integer value);
+        void writeFloat(Value::Float value);
+        void writeString(const QString& string);
+    };
+
+    class ValueView {
+      public:
+        ValueView();
+
+        bool fromJson(const char* json, int size);
+        bool fromBinary(const char* cbor, int size);
+
+        int getSize() const;
+        bool isTruncated() const;
+
+        bool isValid() const;
+        bool isUndefined() const;
+        bool isNull() const;
+        bool isBoolean() const;
+        bool isInteger() const;
+        bool isFloat() const;
+        bool isString() const;
+        bool isArray() const;
+        bool isObject() const;
+
+        Value::Type getType() const;
+
+        Value::Boolean getBoolean(Value::Boolean defaultValue = false) const;
+        Value::Integer getInteger(Value::Integer defaultValue = 0) const;
+        Value::Float getFloat(Value::Float defaultValue = 0) const;
+        Value::String getString(Value::String defaultValue = "") const;
+
+        bool toValue(Value& value) const;
+        Value toValue() const;
+
+        int size() const;
+        bool contains(const char* key) const;
+        bool contains(const QString& key) const;
+
+        ValueView operator[](const char* key) const;
+        ValueView operator[](const QString& key) const;
+        ValueView operator[](int i) const;
+
+        bool operator==(const char* other) const;
+        bool operator==(const QString& other) const;
+        bool operator==(const Value& other) const;
+        bool operator!=(const char* other) const;
+        bool operator!=(const QString& other) const;
+        bool operator!=(const Value& other) const;
+
+      private:
+        typedef enum {
+            ENCODING_NONE = 0,
+            ENCODING_JSON,
+            ENCODING_BINARY
+        } Encoding;
+
+        static const int maxDepth = 512;
+
+        const char* begin;
+        const char* end;
+        Encoding encoding;
+        bool truncated;
+
+        ValueView(const char* begin, const char* end, Encoding encoding);
+
+        ValueView find(const char* key, int size, const QString* string) const;
+        bool equals(const char* string, int size, const QString* other) const;
+    };
+
+    class ValueSnapshot {
+      public:
+        ValueSnapshot();
+        ValueSnapshot(const Value& value);
+        ValueSnapshot(const ValueSnapshot& other);
+        ~ValueSnapshot();
+
+        bool isValid() const;
+        Value::Type getType() const;
+        uint getHash() const;
+
+        Value toValue() const;
+
+        int size() const;
+        bool contains(const ValueKey& key) const;
+
+        ValueSnapshot operator[](const ValueKey& key) const;
+        ValueSnapshot operator[](int i) const;
+
+        const ValueSnapshot& operator=(const ValueSnapshot& other);
+        bool operator==(const ValueSnapshot& other) const;
+        bool operator!=(const ValueSnapshot& other) const;
+
+        static int getNodeCount();
+
+      private:
+        class Node;
+
+        static QMutex mutex;
+        static QMultiHash<uint, Node*> nodes;
+
+        Node* node;
+
+        ValueSnapshot(Node* node);
+
+        static Node* create(const Value& value);
+        static Node* intern(Node* node);
+        static void release(Node* node);
+        static bool equals(const Node* a, const Node* b);
+    };
+
+    uint qHash(const ValueSnapshot& snapshot, uint seed = 0);
+
+    class ValueArena {
+        friend class ArbitraryValue;
+
+      public:
+        class Scope {
+          public:
+            Scope(ValueArena* arena);
+            ~Scope();
+
+          private:
+            ValueArena* previous;
+        };
+
+        ValueArena(int blockSize = 64 * 1024);
+        ~ValueArena();
+
+        bool reset();
+
+        int getBlockCount() const;
+        int getValueCount() const;
+
+        static ValueArena* current();
+
+      private:
+        Q_DISABLE_COPY(ValueArena)
+
+        static const Logger* logger;
+        static thread_local ValueArena* currentArena;
+
+        QList<char*> blocks;
+        int blockSize;
+        int block;
+        char* pos;
+        char* end;
+        QAtomicInt values;
+
+        void* allocate(size_t size);
+        void release();
+    };
+
     class ArbitraryValueException : public std::exception {
       public:
         ArbitraryValueException();
@@ -361,13 +1089,22 @@ namespace hfsmexec {
         QString message;
     };
 
-    class ArbitraryValue {
+    class ArbitraryValue : public QSharedData {
+        friend class Value;
+
       public:
+        typedef enum {
+            PACKED_NONE = 0,
+            PACKED_INTEGER,
+            PACKED_FLOAT
+        } Packing;
+
         ArbitraryValue();
         ArbitraryValue(ArbitraryValue const &other);
         ~ArbitraryValue();
 
         const Value::Type& getType() const;
+        const Packing& getPacking() const;
 
         void* ptr();
         void const* ptr() const;
@@ -379,12 +1116,29 @@ namespace hfsmexec {
 
         template<typename T>
         void set(T const& other);
+        void set(Value::String&& other);
+        void set(Value::Array&& other);
+        void set(Value::Object&& other);
+        void set(Value::IntegerArray&& other);
+        void set(Value::FloatArray&& other);
         void set(ArbitraryValue const& other);
+        void set(Value const& other);
+
+        int size() const;
+        Value at(int i) const;
 
         bool operator==(ArbitraryValue const& other) const;
 
+        static void* operator new(size_t size);
+        static void operator delete(void* p);
+
       private:
         Value::Type type;
+        Packing packing;
+        bool linked;
+
+        // the elements of a packed array for const access by reference, built on demand and never changed afterwards
+        mutable QAtomicPointer<Value::Array> elements;
 
         union Data {
             void* p;
@@ -394,28 +1148,52 @@ namespace hfsmexec {
             char s[sizeof(Value::String)];
             char a[sizeof(Value::Array)];
             char o[sizeof(Value::Object)];
+            char ia[sizeof(Value::IntegerArray)];
+            char fa[sizeof(Value::FloatArray)];
         } data;
 
         template<typename T>
         void create(T const &v);
+        template<typename T>
+        void emplace(T& v);
         void create(Value::Type t);
-        void create(Value::Type t, Data const& other);
+        void create(Value::Type t, Packing p, Data const& other);
 
         void destroy();
+        void take(ArbitraryValue& other);
+        void unshare();
+        void unpack();
+        void promote();
+        const Value::Array& unpacked() const;
+        void discardUnpacked();
+
+        static ValueArena* arenaOf(const ArbitraryValue* value);
+        static void unshare(Value::Array& array);
     };
 
-    class ValueScriptBinding : public QScriptClass {
+    class ValueScriptBinding : public QObject, public QScriptClass {
       public:
         virtual QScriptValue property(const QScriptValue& object, const QScriptString& name, uint id);
         virtual void setProperty(QScriptValue& object, const QScriptString& name, uint id, const QScriptValue& newValue);
         virtual QueryFlags queryProperty(const QScriptValue& object, const QScriptString& name, QueryFlags flags, uint* id);
 
+        static ValueScriptBinding* getBinding(QScriptEngine* engine);
         static QScriptValue create(QScriptEngine* engine, Value* value);
+        static const Value* getValue(const QScriptValue& object);
+        static int getBindingCount();
+        int getWrapperCount() const;
 
       private:
+        static QMutex mutex;
+        static QHash<QScriptEngine*, ValueScriptBinding*> bindings;
+
+        QHash<Value*, QScriptValue> wrappers;
+
         ValueScriptBinding(QScriptEngine* engine);
         ~ValueScriptBinding();
 
+        static Value* getMutableValue(const QScriptValue& object);
+
         void setPropertyFromArray(const QVariantList& list, Value* value);
         void setPropertyFromObject(const QVariantMap& map, Value* value);
     };
@@ -36,6 +36,7 @@ Api::Api() {
     assign("/statemachine/start", "POST", std::bind(&Api::statemachineStart, this, std::placeholders::_1, std::placeholders::_2));
     assign("/statemachine/stop", "POST", std::bind(&Api::statemachineStop, this, std::placeholders::_1, std::placeholders::_2));
     assign("/statemachine/event", "POST", std::bind(&Api::statemachineEvent, this, std::placeholders::_1, std::placeholders::_2));
+    assign("/statemachine/events", "POST", std::bind(&Api::statemachineEvents, this, std::placeholders::_1, std::placeholders::_2));
 }
 
 Api::~Api() {
@@ -55,21 +56,32 @@ void Api::quit() {
 
     logPushNotification.unlock();
     statePushNotification.unlock();
+    stateBinaryPushNotification.unlock();
 
     server.stop();
 }
 
 void Api::pushlog(const Value& value) {
-    QString data;
+    QByteArray data;
     if (value.toJson(data)) {
-        logPushNotification.write(data.toStdString());
+        logPushNotification.write(std::string(data.constData(), data.size()));
     }
 }
 
 void Api::pushState(const Value& value) {
-    QString data;
+    QByteArray data;
     if (value.toJson(data)) {
-        statePushNotification.write(data.toStdString());
+        statePushNotification.write(std::string(data.constData(), data.size()));
+    }
+
+    // state changes are only encoded as CBOR while a binary client polls for them
+    if (!stateBinaryPushNotification.isSubscribed()) {
+        return;
+    }
+
+    data.clear();
+    if (value.toBinary(data)) {
+        stateBinaryPushNotification.write(std::string(data.constData(), data.size()));
     }
 }
 
@@ -88,7 +100,8 @@ void Api::log(HttpRequest* request, HttpResponse* response) {
 
 void Api::statemachineLoad(HttpRequest* request, HttpResponse* response) {
     Value value;
-    if (!value.fromJson(request->getBody().c_str())) {
+    const std::string& body = request->getBody();
+    if (!value.fromJson(body.data(), body.size())) {
         response->setStatusCode(HttpResponse::STATUS_BAD_REQUEST);
 
         return;
@@ -123,6 +136,30 @@ void Api::statemachineUnload(HttpRequest* request, HttpResponse* response) {
 
 void Api::statemachineState(HttpRequest* request, HttpResponse* response) {
     int index = std::strtol(request->getHeader("Push-Notification-Index").c_str(), NULL, 10);
+
+    // binary clients get a CBOR array of the state changes
+    if (isBinary(request->getHeader("Accept"))) {
+        std::vector<std::string> messages;
+        if (stateBinaryPushNotification.read(index, messages, 30)) {
+            QByteArray data;
+            ValueCborWriter writer(data);
+            writer.writeArray(messages.size());
+            for (unsigned int i = 0; i < messages.size(); i++) {
+                data.append(messages[i].data(), messages[i].size());
+            }
+
+            response->setStatusCode(HttpResponse::STATUS_OK);
+            response->setHeader("Content-Type", "application/cbor");
+            response->setHeader("Push-Notification-Index", std::to_string(index));
+            response->write(std::string(data.constData(), data.size()));
+        } else {
+            response->setStatusCode(HttpResponse::STATUS_NOT_MODIFIED);
+            response->setHeader("Push-Notification-Index", std::to_string(index));
+        }
+
+        return;
+    }
+
     std::string data;
     if (statePushNotification.read(index, data, 30)) {
         response->setStatusCode(HttpResponse::STATUS_OK);
@@ -155,29 +192,113 @@ void Api::statemachineStop(HttpRequest* request, HttpResponse* response) {
 }
 
 void Api::statemachineEvent(HttpRequest* request, HttpResponse* response) {
-    Value value;
-    if (!value.fromJson(request->getBody().c_str())) {
+    // the body is only viewed, nothing but the payload is decoded. The payload is decoded once and shared from the
+    // event into the conditions and dataflows.
+    ValueView value;
+    const std::string& body = request->getBody();
+    bool ok;
+    if (isBinary(request->getHeader("Content-Type"))) {
+        ok = value.fromBinary(body.data(), body.size());
+    } else {
+        ok = value.fromJson(body.data(), body.size());
+    }
+
+    if (!ok || !value.contains("event")) {
         response->setStatusCode(HttpResponse::STATUS_BAD_REQUEST);
 
         return;
     }
 
-    if (!value.contains("event")) {
+    NamedEvent* event = new NamedEvent(value["event"].getString());
+    if (!setEvent(value, event)) {
+        delete event;
         response->setStatusCode(HttpResponse::STATUS_BAD_REQUEST);
 
         return;
     }
 
-    NamedEvent* event = new NamedEvent(value["event"].getString());
+    // the event is gone if the state machine couldn't take it, e.g. because its queue is full
     if (!Application::getInstance()->postEvent(event)) {
+        response->setStatusCode(HttpResponse::STATUS_SERVICE_UNAVAILABLE);
+
+        return;
+    }
+
+    response->setStatusCode(HttpResponse::STATUS_OK);
+}
+
+void Api::statemachineEvents(HttpRequest* request, HttpResponse* response) {
+    // elements of a view are found by scanning, so the list is decoded as a whole. The payloads share its nodes.
+    Value value;
+    const std::string& body = request->getBody();
+    bool ok;
+    if (isBinary(request->getHeader("Content-Type"))) {
+        ok = value.fromBinary(body.data(), body.size());
+    } else {
+        ok = value.fromJson(body.data(), body.size());
+    }
+
+    if (!ok || !value.contains("events") || !value["events"].isArray()) {
         response->setStatusCode(HttpResponse::STATUS_BAD_REQUEST);
 
         return;
     }
 
+    // the whole request is rejected if one of the events is invalid
+    const Value& eventValues = value["events"];
+    QList<AbstractEvent*> events;
+    events.reserve(eventValues.size());
+    for (int i = 0; i < eventValues.size(); i++) {
+        const Value& eventValue = eventValues[i];
+        if (!eventValue.contains("event")) {
+            qDeleteAll(events);
+            response->setStatusCode(HttpResponse::STATUS_BAD_REQUEST);
+
+            return;
+        }
+
+        NamedEvent* event = new NamedEvent(eventValue["event"].getString());
+        if (eventValue.contains("origin")) {
+            event->setOrigin(eventValue["origin"].getString());
+        }
+        if (eventValue.contains("message")) {
+            event->setMessage(eventValue["message"].getString());
+        }
+        if (eventValue.contains("payload")) {
+            event->setPayload(eventValue["payload"]);
+        }
+        events.append(event);
+    }
+
+    if (!Application::getInstance()->postEvents(events)) {
+        response->setStatusCode(HttpResponse::STATUS_SERVICE_UNAVAILABLE);
+
+        return;
+    }
+
     response->setStatusCode(HttpResponse::STATUS_OK);
 }
 
+bool Api::setEvent(const ValueView& value, NamedEvent* event) {
+    if (value.contains("origin")) {
+        event->setOrigin(value["origin"].getString());
+    }
+
+    if (value.contains("message")) {
+        event->setMessage(value["message"].getString());
+    }
+
+    if (value.contains("payload")) {
+        return value["payload"].toValue(event->getPayload());
+    }
+
+    return true;
+}
+
+bool Api::isBinary(const std::string& mediaType) {
+    return mediaType.find("application/cbor") != std::string::npos;
+}
+
 void Api::assign(QString pattern, QString method, std::function<void(HttpRequest*, HttpResponse*)> handler) {
     Service service;
     service.pattern = pattern;
@@ -193,7 +314,7 @@ void Api::httpHandler(HttpRequest* request, HttpResponse* response) {
     response->setHeader("Access-Control-Allow-Origin", "*");
     response->setHeader("Access-Control-Expose-Headers", "Push-Notification-Index");
     response->setHeader("Access-Control-Allow-Methods", "GET, POST, DELETE, PUT");
-    response->setHeader("Access-Control-Allow-Headers", "Push-Notification-Index");
+    response->setHeader("Access-Control-Allow-Headers", "Push-Notification-Index, Content-Type, Accept");
 
     // handle OPTIONS method send by browsers before actual request
     if (request->getMethod() == "OPTIONS") {
@@ -33,6 +33,7 @@ Configuration::Configuration() {
     apiPort = 8080;
     loggerFile = "hfsm-exec.log";
     pluginDirs = QStringList() <<"plugins";
+    nativeEngine = false;
 }
 
 Configuration::~Configuration() {
@@ -55,6 +56,7 @@ void Configuration::load() {
     QCommandLineOption commandImportStatemachine(QStringList() <<"i" <<"import", "Import a state machine.", "filename");
     QCommandLineOption commandExportStatemachine(QStringList() <<"o" <<"export", "Export the imported state machine.", "filename");
     QCommandLineOption commandEncoding(QStringList() <<"e" <<"encoding", "Encoding of the imported/exported state machine.", "encoding");
+    QCommandLineOption commandNativeEngine(QStringList() <<"n" <<"native-engine", "Execute state machines with the native engine instead of the Qt state machine framework.");
 
     commandLineParser.addHelpOption();
     commandLineParser.addVersionOption();
@@ -66,6 +68,7 @@ void Configuration::load() {
     commandLineParser.addOption(commandImportStatemachine);
     commandLineParser.addOption(commandExportStatemachine);
     commandLineParser.addOption(commandEncoding);
+    commandLineParser.addOption(commandNativeEngine);
 
     // process command line
     commandLineParser.process(Application::getInstance()->getQtApplication());
@@ -115,6 +118,11 @@ void Configuration::load() {
             exportEncoding = encodings[1];
         }
     }
+
+    // native engine
+    if (commandLineParser.isSet(commandNativeEngine)) {
+        nativeEngine = true;
+    }
 }
 
 /*
@@ -229,10 +237,20 @@ bool Application::postEvent(AbstractEvent* event) {
     logger->info("post event to the executing state machine");
 
     if (stateMachine != NULL) {
-        stateMachine->postEvent(event);
+        return stateMachine->postEvent(event);
+    }
+    delete event;
 
-        return true;
+    return false;
+}
+
+bool Application::postEvents(const QList<AbstractEvent*>& events) {
+    logger->info(QString("post %1 events to the executing state machine").arg(events.size()));
+
+    if (stateMachine != NULL) {
+        return stateMachine->postEvents(events);
     }
+    qDeleteAll(events);
 
     return false;
 }
@@ -262,6 +280,7 @@ bool Application::loadStateMachine(const QString& encoding, const QString& data)
 
     logger->info("loaded state machine");
 
+    stateMachine->setNativeEngine(configuration.nativeEngine);
     this->stateMachine = stateMachine;
 
     return true;
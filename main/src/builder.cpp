@@ -16,6 +16,7 @@
  */
 
 #include <builder.h>
+#include <topology.h>
 
 using namespace hfsmexec;
 
@@ -37,12 +38,17 @@ void StateMachineBuilder::addState(StateMachine* stateMachine) {
     if (this->stateMachine == NULL) {
         this->stateMachine = stateMachine;
     } else {
-        states.append(stateMachine);
+        addState(static_cast<AbstractState*>(stateMachine));
     }
 }
 
 void StateMachineBuilder::addState(AbstractState* state) {
     states.append(state);
+
+    // the first state with an id is found, like a search in insertion order
+    if (!stateIds.contains(state->getId())) {
+        stateIds.insert(state->getId(), state);
+    }
 }
 
 void StateMachineBuilder::addTransition(AbstractTransition* transition) {
@@ -68,6 +74,11 @@ StateMachine* StateMachineBuilder::build() {
 
     logger->info("create state machine");
 
+    stateMachine->stateIds = stateIds;
+    stateMachine->stateIds.insert(stateMachine->getId(), stateMachine);
+    stateMachine->childStateIds.clear();
+    stateMachine->transitionIds.clear();
+
     // link states
     logger->info("link states");
     for (int i = 0; i < states.size(); i++) {
@@ -84,6 +95,10 @@ StateMachine* StateMachineBuilder::build() {
         // link state
         logger->info(QString("link child state \"%1\" with parent state \"%2\"").arg(state->getId()).arg(parentState->getId()));
         parentState->childStates.append(state);
+        QPair<const AbstractState*, QString> childKey(parentState, state->getId());
+        if (!stateMachine->childStateIds.contains(childKey)) {
+            stateMachine->childStateIds.insert(childKey, state);
+        }
         state->setParent(parentState);
         state->getDelegate()->setParent(parentState->getDelegate());
 
@@ -91,6 +106,11 @@ StateMachine* StateMachineBuilder::build() {
         state->stateMachine = stateMachine;
     }
 
+    // index the hierarchy, lookups of states by id use it from here on
+    delete stateMachine->topology;
+    stateMachine->topology = new StateMachineTopology();
+    stateMachine->topology->addStates(stateMachine);
+
     // link dataflows
     for (int i = 0; i < dataflows.size(); i++) {
         Dataflow* dataflow = dataflows[i];
@@ -121,7 +141,33 @@ StateMachine* StateMachineBuilder::build() {
 
         const QList<Assign*>& assigns = dataflow->getAssigns();
         for (int j = 0; j < assigns.size(); j++) {
-            targetParameters.getValue(assigns[j]->getTo()) = &sourceParameters.getValue(assigns[j]->getFrom());
+            Assign* assign = assigns[j];
+            if ((!assign->isTransformation() && !assign->getFromPath().isValid()) || !assign->getToPath().isValid()) {
+                logger->warning(QString("initialization failed: invalid path in %1").arg(assign->toString()));
+
+                return NULL;
+            }
+
+            // transformations are compiled here and evaluated when the target state is entered
+            if (assign->isTransformation()) {
+                // only complex states evaluate their dataflows on entry, a final state would never see the result
+                if (qobject_cast<FinalState*>(targetState) != NULL) {
+                    logger->warning(QString("initialization failed: transformation into final state \"%1\" in %2").arg(targetState->getId()).arg(assign->toString()));
+
+                    return NULL;
+                }
+
+                assign->stateMachine = stateMachine;
+                if (!assign->initialize()) {
+                    logger->warning(QString("initialization failed: invalid expression in %1").arg(assign->toString()));
+
+                    return NULL;
+                }
+
+                continue;
+            }
+
+            targetParameters.getValue(assign->getToPath()) = &sourceParameters.getValue(assign->getFromPath());
         }
 
         dataflow->stateMachine = stateMachine;
@@ -176,6 +222,10 @@ StateMachine* StateMachineBuilder::build() {
         }
 
         sourceState->transitions.append(transition);
+        QPair<const AbstractState*, QString> transitionKey(sourceState, transition->getId());
+        if (!stateMachine->transitionIds.contains(transitionKey)) {
+            stateMachine->transitionIds.insert(transitionKey, transition);
+        }
         transition->stateMachine = stateMachine;
         transition->sourceState = sourceState;
         transition->targetState = targetState;
@@ -188,6 +238,14 @@ StateMachine* StateMachineBuilder::build() {
         }
     }
 
+    // precompute domains and entry sets of all transitions
+    logger->info("compute topology");
+    if (!stateMachine->topology->addTransitions()) {
+        logger->warning("initialization failed: couldn't compute topology of the state machine");
+
+        return NULL;
+    }
+
     logger->info("successfully created state machine");
 
     return stateMachine;
@@ -222,11 +280,5 @@ AbstractState* StateMachineBuilder::getState(const QString& stateId) {
         return stateMachine;
     }
 
-    for (int i = 0; i < states.size(); i++) {
-        if (states[i]->getId() == stateId) {
-            return states[i];
-        }
-    }
-
-    return NULL;
+    return stateIds.value(stateId, NULL);
 }
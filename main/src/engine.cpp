@@ -0,0 +1,521 @@
+/*
+ *  Copyright (C) 2014 Marcel Lehwald
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <engine.h>
+
+#include <QMutexLocker>
+#include <QThread>
+#include <QTimerEvent>
+
+#include <algorithm>
+
+using namespace hfsmexec;
+
+/*
+ * StateMachineEngine
+ */
+const Logger* StateMachineEngine::logger = Logger::getLogger(LOGGER_STATEMACHINE);
+
+StateMachineEngine::StateMachineEngine(StateMachine* stateMachine) :
+    stateMachine(stateMachine),
+    topology(NULL),
+    compiled(false),
+    changed(false),
+    transitionCount(0),
+    queue(16384),
+    batch(256),
+    running(0),
+    scheduled(0),
+    nextDelayedEvent(0),
+    pendingStart(false),
+    pendingStop(false) {
+
+}
+
+StateMachineEngine::~StateMachineEngine() {
+    AbstractEvent* event;
+    while ((event = queue.dequeue()) != NULL) {
+        delete event;
+    }
+    qDeleteAll(priorityQueue);
+    qDeleteAll(overflowQueue);
+    qDeleteAll(delayedEvents);
+}
+
+bool StateMachineEngine::compile() {
+    compiled = false;
+    complexStates.clear();
+    eventTransitions.clear();
+    otherTransitions.clear();
+    invokeDoneEvents.clear();
+
+    topology = stateMachine->getTopology();
+    if (topology == NULL) {
+        logger->warning(QString("%1 can't be compiled: the state machine wasn't built").arg(stateMachine->toString()));
+
+        return false;
+    }
+
+    for (int i = 0; i < topology->size(); i++) {
+        complexStates.append(qobject_cast<AbstractComplexState*>(topology->getState(i)));
+
+        if (topology->getKind(i) == StateMachineTopology::KIND_INVOKE) {
+            invokeDoneEvents.insert(static_cast<InvokeState*>(topology->getState(i))->doneEventId, i);
+        }
+    }
+
+    const QVector<StateMachineTopology::Transition>& transitions = topology->getTransitions();
+    for (int i = 0; i < transitions.size(); i++) {
+        ConditionalTransition* conditionalTransition = dynamic_cast<ConditionalTransition*>(transitions[i].transition);
+        if (conditionalTransition != NULL) {
+            eventTransitions[conditionalTransition->getEventId()].append(i);
+        } else {
+            otherTransitions.append(i);
+        }
+    }
+
+    // transitions without event are tested for every named event too, candidates are ordered by source state
+    if (!otherTransitions.isEmpty()) {
+        for (QHash<int, QVector<int> >::iterator it = eventTransitions.begin(); it != eventTransitions.end(); ++it) {
+            it.value() += otherTransitions;
+            std::sort(it.value().begin(), it.value().end());
+        }
+    }
+
+    active.fill(false, topology->size());
+    completed.fill(false, topology->size());
+    published = active;
+    changed = false;
+
+    logger->info(QString("%1 compiled %2 states and %3 transitions").arg(stateMachine->toString()).arg(topology->size()).arg(transitions.size()));
+
+    compiled = true;
+
+    return true;
+}
+
+void StateMachineEngine::start() {
+    if (!compiled && !compile()) {
+        return;
+    }
+
+    QMutexLocker locker(&mutex);
+
+    if (running.loadAcquire()) {
+        return;
+    }
+
+    running.storeRelease(1);
+    pendingStart = true;
+    pendingStop = false;
+    schedule();
+}
+
+void StateMachineEngine::stop() {
+    QMutexLocker locker(&mutex);
+
+    if (!running.loadAcquire()) {
+        return;
+    }
+
+    pendingStop = true;
+    schedule();
+}
+
+bool StateMachineEngine::isRunning() {
+    return running.loadAcquire();
+}
+
+bool StateMachineEngine::postEvent(AbstractEvent* event, bool highPriority) {
+    if (!running.loadAcquire()) {
+        delete event;
+
+        return false;
+    }
+
+    if (highPriority) {
+        QMutexLocker locker(&mutex);
+        priorityQueue.prepend(event);
+    } else if (!queue.enqueue(event)) {
+        // the machine thread can't wait for the queue to be drained by itself, its own events are kept aside
+        if (QThread::currentThread() == thread()) {
+            QMutexLocker locker(&mutex);
+            overflowQueue.append(event);
+        } else {
+            logger->warning(QString("%1 reject event %2: event queue is full").arg(stateMachine->toString()).arg(event->toString()));
+            delete event;
+
+            return false;
+        }
+    }
+
+    schedule();
+
+    return true;
+}
+
+bool StateMachineEngine::postEvents(const QList<AbstractEvent*>& events, bool highPriority) {
+    if (!running.loadAcquire()) {
+        qDeleteAll(events);
+
+        return false;
+    }
+
+    if (highPriority) {
+        QMutexLocker locker(&mutex);
+        for (int i = events.size() - 1; i >= 0; i--) {
+            priorityQueue.prepend(events[i]);
+        }
+    } else if (!queue.enqueue(events)) {
+        if (QThread::currentThread() == thread()) {
+            QMutexLocker locker(&mutex);
+            overflowQueue.append(events);
+        } else {
+            logger->warning(QString("%1 reject %2 events: event queue is full").arg(stateMachine->toString()).arg(events.size()));
+            qDeleteAll(events);
+
+            return false;
+        }
+    }
+
+    schedule();
+
+    return true;
+}
+
+int StateMachineEngine::postDelayedEvent(AbstractEvent* event, int delay) {
+    QMutexLocker locker(&mutex);
+
+    // timers belong to the machine thread, so the timer is started there
+    int id = nextDelayedEvent++;
+    delayedEvents.insert(id, event);
+    QMetaObject::invokeMethod(this, "startDelayedEvent", Qt::QueuedConnection, Q_ARG(int, id), Q_ARG(int, delay));
+
+    return id;
+}
+
+bool StateMachineEngine::isActive(const AbstractState* state) const {
+    int index = compiled ? topology->indexOf(state) : -1;
+
+    QMutexLocker locker(&mutex);
+
+    return index >= 0 && published.value(index, false);
+}
+
+qint64 StateMachineEngine::getTransitionCount() const {
+    return transitionCount;
+}
+
+void StateMachineEngine::timerEvent(QTimerEvent* event) {
+    killTimer(event->timerId());
+
+    mutex.lock();
+    AbstractEvent* delayedEvent = NULL;
+    if (delayedTimers.contains(event->timerId())) {
+        delayedEvent = delayedEvents.take(delayedTimers.take(event->timerId()));
+    }
+    mutex.unlock();
+
+    if (delayedEvent != NULL) {
+        postEvent(delayedEvent);
+    }
+}
+
+void StateMachineEngine::process() {
+    // events posted from now on schedule another run
+    scheduled.fetchAndStoreOrdered(0);
+
+    mutex.lock();
+    if (pendingStart) {
+        pendingStart = false;
+        mutex.unlock();
+        enterInitial();
+        mutex.lock();
+    }
+
+    while (running.loadAcquire()) {
+        publish();
+
+        if (pendingStop) {
+            pendingStop = false;
+            running.storeRelease(0);
+            mutex.unlock();
+            halt();
+            mutex.lock();
+
+            break;
+        }
+
+        if (!priorityQueue.isEmpty()) {
+            AbstractEvent* event = priorityQueue.takeFirst();
+            mutex.unlock();
+            step(event);
+            delete event;
+            mutex.lock();
+
+            continue;
+        }
+        mutex.unlock();
+
+        int count = queue.dequeue(batch.data(), batch.size());
+        for (int i = 0; i < count; i++) {
+            // the state machine may finish in the middle of a batch
+            if (running.loadAcquire()) {
+                step(batch[i]);
+            }
+            delete batch[i];
+        }
+
+        mutex.lock();
+        if (count == 0) {
+            if (overflowQueue.isEmpty()) {
+                break;
+            }
+
+            // events the machine thread posted while the queue was full
+            AbstractEvent* event = overflowQueue.takeFirst();
+            mutex.unlock();
+            step(event);
+            delete event;
+            mutex.lock();
+        }
+    }
+
+    publish();
+    mutex.unlock();
+}
+
+void StateMachineEngine::startDelayedEvent(int id, int delay) {
+    QMutexLocker locker(&mutex);
+
+    // the event is gone if the state machine was stopped in the meantime
+    if (delayedEvents.contains(id)) {
+        delayedTimers.insert(startTimer(delay), id);
+    }
+}
+
+void StateMachineEngine::schedule() {
+    // only the first event after a run wakes up the machine thread
+    if (scheduled.testAndSetOrdered(0, 1)) {
+        QMetaObject::invokeMethod(this, "process", Qt::QueuedConnection);
+    }
+}
+
+void StateMachineEngine::publish() {
+    // called with the mutex locked, the copy is shared until the configuration changes again
+    if (changed) {
+        published = active;
+        changed = false;
+    }
+}
+
+void StateMachineEngine::enterInitial() {
+    active.fill(false);
+    completed.fill(false);
+
+    for (int i = 0; i < topology->size(); i++) {
+        if (complexStates[i] != NULL) {
+            complexStates[i]->eventStart();
+        }
+    }
+
+    enter(topology->getInitialEntries());
+}
+
+void StateMachineEngine::halt() {
+    AbstractEvent* event;
+    while ((event = queue.dequeue()) != NULL) {
+        delete event;
+    }
+
+    mutex.lock();
+    qDeleteAll(priorityQueue);
+    priorityQueue.clear();
+    qDeleteAll(overflowQueue);
+    overflowQueue.clear();
+    QList<int> timers = delayedTimers.keys();
+    qDeleteAll(delayedEvents);
+    delayedEvents.clear();
+    delayedTimers.clear();
+    mutex.unlock();
+
+    for (int i = 0; i < timers.size(); i++) {
+        killTimer(timers[i]);
+    }
+
+    for (int i = 0; i < topology->size(); i++) {
+        if (complexStates[i] != NULL) {
+            complexStates[i]->eventStop();
+        }
+    }
+
+    active.fill(false);
+    completed.fill(false);
+    changed = true;
+}
+
+void StateMachineEngine::step(AbstractEvent* event) {
+    // an invocation is done
+    if (event->type() == InternalEvent::type) {
+        int state = invokeDoneEvents.value(static_cast<InternalEvent*>(event)->getEventId(), -1);
+        if (state >= 0 && active[state] && !completed[state]) {
+            complete(state);
+        }
+
+        return;
+    }
+
+    // candidates are ordered by source state, so the first enabled transition of every source is found first
+    const QVector<int>* candidates = &otherTransitions;
+    if (event->type() == NamedEvent::type) {
+        QHash<int, QVector<int> >::const_iterator it = eventTransitions.constFind(static_cast<NamedEvent*>(event)->getEventId());
+        if (it != eventTransitions.constEnd()) {
+            candidates = &it.value();
+        }
+    }
+
+    selected.clear();
+    int lastSource = -1;
+    for (int i = 0; i < candidates->size(); i++) {
+        const StateMachineTopology::Transition& transition = topology->getTransitions()[(*candidates)[i]];
+        if (!active[transition.source] || transition.source == lastSource || !transition.transition->eventTest(event)) {
+            continue;
+        }
+        lastSource = transition.source;
+
+        // transitions conflict if their exit sets overlap, transitions of descendants win, otherwise the first one
+        bool preempted = false;
+        for (int j = 0; j < selected.size() && !preempted;) {
+            const StateMachineTopology::Transition& other = topology->getTransitions()[selected[j]];
+            if (topology->contains(transition.domain, other.domain) || topology->contains(other.domain, transition.domain)) {
+                if (other.source != transition.source && topology->contains(other.source, transition.source)) {
+                    selected.remove(j);
+
+                    continue;
+                }
+                preempted = true;
+            }
+            j++;
+        }
+
+        if (!preempted) {
+            selected.append((*candidates)[i]);
+        }
+    }
+
+    if (!selected.isEmpty()) {
+        execute(event);
+    }
+}
+
+void StateMachineEngine::execute(AbstractEvent* event) {
+    // exit
+    exitSet.clear();
+    for (int i = 0; i < selected.size(); i++) {
+        const StateMachineTopology::Transition& transition = topology->getTransitions()[selected[i]];
+        for (int state = transition.domain + 1; state < topology->getEnd(transition.domain); state++) {
+            if (active[state]) {
+                exitSet.append(state);
+            }
+        }
+    }
+    std::sort(exitSet.begin(), exitSet.end());
+    exitSet.erase(std::unique(exitSet.begin(), exitSet.end()), exitSet.end());
+
+    changed = true;
+    for (int i = exitSet.size() - 1; i >= 0; i--) {
+        int state = exitSet[i];
+        active[state] = false;
+        completed[state] = false;
+        if (complexStates[state] != NULL) {
+            complexStates[state]->eventExit();
+        }
+    }
+
+    // transition
+    entrySet.clear();
+    for (int i = 0; i < selected.size(); i++) {
+        const StateMachineTopology::Transition& transition = topology->getTransitions()[selected[i]];
+        transition.transition->onTransition(event);
+        const int* entries = topology->getEntries(transition);
+        for (int j = 0; j < transition.entryCount; j++) {
+            entrySet.append(entries[j]);
+        }
+        transitionCount++;
+    }
+    std::sort(entrySet.begin(), entrySet.end());
+    entrySet.erase(std::unique(entrySet.begin(), entrySet.end()), entrySet.end());
+
+    // enter
+    enter(entrySet);
+}
+
+void StateMachineEngine::enter(const QVector<int>& set) {
+    changed = true;
+    for (int i = 0; i < set.size(); i++) {
+        int state = set[i];
+        active[state] = true;
+        completed[state] = false;
+        if (complexStates[state] != NULL) {
+            complexStates[state]->eventEnter();
+        }
+    }
+
+    // completion is only reported once the whole configuration is entered
+    for (int i = 0; i < set.size() && running.loadAcquire(); i++) {
+        int state = set[i];
+        if (topology->getKind(state) == StateMachineTopology::KIND_FINAL && active[state]) {
+            completed[state] = true;
+            completeParent(state);
+        }
+    }
+}
+
+void StateMachineEngine::complete(int state) {
+    completed[state] = true;
+    if (complexStates[state] != NULL) {
+        complexStates[state]->eventFinish();
+    }
+
+    // the state machine itself finished
+    if (state == 0) {
+        running.storeRelease(0);
+        halt();
+
+        return;
+    }
+
+    completeParent(state);
+}
+
+void StateMachineEngine::completeParent(int state) {
+    int parent = topology->getParent(state);
+    if (parent < 0 || completed[parent]) {
+        return;
+    }
+
+    if (topology->getKind(parent) == StateMachineTopology::KIND_COMPOUND && topology->getKind(state) == StateMachineTopology::KIND_FINAL) {
+        complete(parent);
+    } else if (topology->getKind(parent) == StateMachineTopology::KIND_PARALLEL) {
+        for (int child = parent + 1; child < topology->getEnd(parent); child = topology->getEnd(child)) {
+            if (!completed[child]) {
+                return;
+            }
+        }
+        complete(parent);
+    }
+}
@@ -0,0 +1,134 @@
+/*
+ *  Copyright (C) 2014 Marcel Lehwald
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <eventqueue.h>
+
+using namespace hfsmexec;
+
+/*
+ * EventQueue
+ */
+EventQueue::EventQueue(int capacity) :
+    mask(1),
+    enqueuePosition(0),
+    dequeuePosition(0) {
+    // positions map to slots by masking, so the capacity is a power of two
+    while ((int)mask < capacity) {
+        mask <<= 1;
+    }
+
+    slots = new Slot[mask];
+    for (quint32 i = 0; i < mask; i++) {
+        slots[i].sequence.store((int)i);
+        slots[i].event = NULL;
+    }
+    mask--;
+}
+
+EventQueue::~EventQueue() {
+    delete[] slots;
+}
+
+int EventQueue::getCapacity() const {
+    return mask + 1;
+}
+
+bool EventQueue::enqueue(AbstractEvent* event) {
+    quint32 position = (quint32)enqueuePosition.load();
+    for (;;) {
+        Slot& slot = slots[position & mask];
+        qint32 difference = (qint32)((quint32)slot.sequence.loadAcquire() - position);
+
+        if (difference == 0) {
+            // the slot is free, claim the position
+            if (enqueuePosition.testAndSetRelaxed((int)position, (int)(position + 1))) {
+                slot.event = event;
+                slot.sequence.storeRelease((int)(position + 1));
+
+                return true;
+            }
+            position = (quint32)enqueuePosition.load();
+        } else if (difference < 0) {
+            // the consumer hasn't released the slot yet, the queue is full
+            return false;
+        } else {
+            // another producer claimed the position
+            position = (quint32)enqueuePosition.load();
+        }
+    }
+}
+
+bool EventQueue::enqueue(const QList<AbstractEvent*>& events) {
+    quint32 count = events.size();
+    if (count == 0) {
+        return true;
+    }
+
+    if (count > mask + 1) {
+        return false;
+    }
+
+    quint32 position = (quint32)enqueuePosition.load();
+    for (;;) {
+        // the consumer frees slots in order, if the last slot is free all of them are
+        Slot& last = slots[(position + count - 1) & mask];
+        qint32 difference = (qint32)((quint32)last.sequence.loadAcquire() - (position + count - 1));
+
+        if (difference == 0) {
+            if (enqueuePosition.testAndSetRelaxed((int)position, (int)(position + count))) {
+                for (quint32 i = 0; i < count; i++) {
+                    Slot& slot = slots[(position + i) & mask];
+                    slot.event = events[i];
+                    slot.sequence.storeRelease((int)(position + i + 1));
+                }
+
+                return true;
+            }
+            position = (quint32)enqueuePosition.load();
+        } else if (difference < 0) {
+            return false;
+        } else {
+            position = (quint32)enqueuePosition.load();
+        }
+    }
+}
+
+AbstractEvent* EventQueue::dequeue() {
+    AbstractEvent* event = NULL;
+
+    return dequeue(&event, 1) == 1 ? event : NULL;
+}
+
+int EventQueue::dequeue(AbstractEvent** events, int count) {
+    int i = 0;
+    for (; i < count; i++) {
+        Slot& slot = slots[dequeuePosition & mask];
+        if ((qint32)((quint32)slot.sequence.loadAcquire() - (dequeuePosition + 1)) < 0) {
+            break;
+        }
+
+        events[i] = slot.event;
+        slot.event = NULL;
+
+        // free the slot for the producer one lap ahead
+        slot.sequence.storeRelease((int)(dequeuePosition + mask + 1));
+        dequeuePosition++;
+    }
+
+    return i;
+}
@@ -0,0 +1,928 @@
+/*
+ *  Copyright (C) 2014 Marcel Lehwald
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <expression.h>
+
+#include <QStringList>
+#include <QVarLengthArray>
+
+#include <cmath>
+#include <limits>
+
+using namespace hfsmexec;
+
+/*
+ * operands
+ */
+namespace {
+    typedef enum {
+        KIND_UNDEFINED = 0,
+        KIND_NULL,
+        KIND_BOOLEAN,
+        KIND_NUMBER,
+        KIND_STRING,
+        KIND_VALUE
+    } Kind;
+
+    // arrays and objects are only referenced, everything else is converted like the script binding does
+    struct Operand {
+        Kind kind;
+        bool boolean;
+        double number;
+        QString string;
+        const Value* value;
+    };
+}
+
+static void load(const Value& value, Operand& operand) {
+    switch (value.getType()) {
+    case Value::TYPE_BOOLEAN:
+        operand.kind = KIND_BOOLEAN;
+        operand.boolean = value.getBoolean();
+        break;
+    case Value::TYPE_INTEGER:
+        // scripts get integers as double by ValueScriptBinding, results have to match
+        operand.kind = KIND_NUMBER;
+        operand.number = static_cast<double>(value.getInteger());
+        break;
+    case Value::TYPE_FLOAT:
+        operand.kind = KIND_NUMBER;
+        operand.number = value.getFloat();
+        break;
+    case Value::TYPE_STRING:
+        operand.kind = KIND_STRING;
+        operand.string = value.getStringRef();
+        break;
+    case Value::TYPE_ARRAY:
+    case Value::TYPE_OBJECT:
+        operand.kind = KIND_VALUE;
+        operand.value = &value;
+        break;
+    default:
+        // null values are undefined in scripts as well
+        operand.kind = KIND_UNDEFINED;
+        break;
+    }
+}
+
+static double stringToNumber(const QString& string) {
+    QString s = string.trimmed();
+    if (s.isEmpty()) {
+        return 0;
+    }
+
+    if (s == "Infinity" || s == "+Infinity") {
+        return std::numeric_limits<double>::infinity();
+    } else if (s == "-Infinity") {
+        return -std::numeric_limits<double>::infinity();
+    }
+
+    bool ok;
+    if (s.size() > 2 && s[0] == '0' && (s[1] == 'x' || s[1] == 'X')) {
+        qulonglong hex = s.mid(2).toULongLong(&ok, 16);
+
+        return ok ? hex : std::numeric_limits<double>::quiet_NaN();
+    }
+
+    // toDouble() accepts "inf" and "nan" as well, which aren't numbers in scripts
+    for (int i = 0; i < s.size(); i++) {
+        if (s[i].isLetter() && s[i] != 'e' && s[i] != 'E') {
+            return std::numeric_limits<double>::quiet_NaN();
+        }
+    }
+
+    double number = s.toDouble(&ok);
+
+    return ok ? number : std::numeric_limits<double>::quiet_NaN();
+}
+
+static double toNumber(const Operand& operand) {
+    switch (operand.kind) {
+    case KIND_NULL:
+        return 0;
+    case KIND_BOOLEAN:
+        return operand.boolean ? 1 : 0;
+    case KIND_NUMBER:
+        return operand.number;
+    case KIND_STRING:
+        return stringToNumber(operand.string);
+    default:
+        return std::numeric_limits<double>::quiet_NaN();
+    }
+}
+
+static bool toBoolean(const Operand& operand) {
+    switch (operand.kind) {
+    case KIND_BOOLEAN:
+        return operand.boolean;
+    case KIND_NUMBER:
+        return operand.number != 0 && !std::isnan(operand.number);
+    case KIND_STRING:
+        return !operand.string.isEmpty();
+    case KIND_VALUE:
+        return true;
+    default:
+        return false;
+    }
+}
+
+static bool strictEquals(const Operand& a, const Operand& b, bool& result) {
+    if (a.kind != b.kind) {
+        result = false;
+
+        return true;
+    }
+
+    switch (a.kind) {
+    case KIND_BOOLEAN:
+        result = a.boolean == b.boolean;
+        break;
+    case KIND_NUMBER:
+        result = a.number == b.number;
+        break;
+    case KIND_STRING:
+        result = a.string == b.string;
+        break;
+    case KIND_VALUE:
+        // scripts compare the identity of wrapper objects
+        return false;
+    default:
+        result = true;
+        break;
+    }
+
+    return true;
+}
+
+static bool looseEquals(const Operand& a, const Operand& b, bool& result) {
+    if (a.kind == b.kind) {
+        return strictEquals(a, b, result);
+    }
+
+    bool aNull = a.kind == KIND_UNDEFINED || a.kind == KIND_NULL;
+    bool bNull = b.kind == KIND_UNDEFINED || b.kind == KIND_NULL;
+    if (aNull || bNull) {
+        result = aNull && bNull;
+
+        return true;
+    }
+
+    // comparing arrays or objects to primitives converts them with toString() or valueOf()
+    if (a.kind == KIND_VALUE || b.kind == KIND_VALUE) {
+        return false;
+    }
+
+    result = toNumber(a) == toNumber(b);
+
+    return true;
+}
+
+// returns -1, 0 or 1, or -2 if the operands can't be ordered
+static int compare(const Operand& a, const Operand& b) {
+    if (a.kind == KIND_STRING && b.kind == KIND_STRING) {
+        int c = QString::compare(a.string, b.string);
+
+        return c < 0 ? -1 : (c > 0 ? 1 : 0);
+    }
+
+    double x = toNumber(a);
+    double y = toNumber(b);
+    if (std::isnan(x) || std::isnan(y)) {
+        return -2;
+    }
+
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+/*
+ * Expression
+ */
+Expression::Expression() :
+    maxDepth(0),
+    valid(false),
+    pos(0),
+    depth(0),
+    token(TOKEN_END),
+    number(0) {
+
+}
+
+Expression::~Expression() {
+
+}
+
+bool Expression::compile(const QString& expression) {
+    program.clear();
+    constants.clear();
+    keys.clear();
+    maxDepth = 0;
+    valid = false;
+    error.clear();
+
+    source = expression;
+    pos = 0;
+    depth = 0;
+    next();
+
+    bool success = parseConditional();
+    if (success && token != TOKEN_END) {
+        success = fail(QString("unexpected \"%1\"").arg(text));
+    }
+    source.clear();
+
+    if (!success) {
+        program.clear();
+
+        return false;
+    }
+
+    valid = true;
+
+    return true;
+}
+
+bool Expression::evaluate(const Value& input, const Value& output, bool& result) const {
+    return evaluate(input, output, Value(), result);
+}
+
+bool Expression::evaluate(const Value& input, const Value& output, Value& result) const {
+    return evaluate(input, output, Value(), result);
+}
+
+bool Expression::evaluate(const Value& input, const Value& output, const Value& event, bool& result) const {
+    Value value;
+    if (!evaluate(input, output, event, value)) {
+        return false;
+    }
+
+    switch (value.getType()) {
+    case Value::TYPE_BOOLEAN:
+        result = value.getBoolean();
+        break;
+    case Value::TYPE_FLOAT:
+        result = value.getFloat() != 0 && !std::isnan(value.getFloat());
+        break;
+    case Value::TYPE_STRING:
+        result = !value.getStringRef().isEmpty();
+        break;
+    case Value::TYPE_ARRAY:
+    case Value::TYPE_OBJECT:
+        result = true;
+        break;
+    default:
+        result = false;
+        break;
+    }
+
+    return true;
+}
+
+bool Expression::evaluate(const Value& input, const Value& output, const Value& event, Value& result) const {
+    if (!valid) {
+        return false;
+    }
+
+    QVarLengthArray<Operand, 16> stack(maxDepth);
+    int top = -1;
+    int pc = 0;
+    while (pc < program.size()) {
+        const Instruction& instruction = program[pc++];
+        switch (instruction.op) {
+        case OP_PUSH: {
+            const Value& constant = constants[instruction.arg];
+            Operand& operand = stack[++top];
+            if (constant.isNull()) {
+                operand.kind = KIND_NULL;
+            } else {
+                load(constant, operand);
+            }
+            break;
+        }
+        case OP_INPUT:
+            load(input, stack[++top]);
+            break;
+        case OP_OUTPUT:
+            load(output, stack[++top]);
+            break;
+        case OP_EVENT:
+            load(event, stack[++top]);
+            break;
+        case OP_KEY: {
+            Operand& operand = stack[top];
+            const ValueKey& key = keys[instruction.arg];
+            if (operand.kind == KIND_VALUE && operand.value->isObject()) {
+                const Value& child = (*operand.value)[key];
+                if (child.isValid()) {
+                    load(child, operand);
+                } else {
+                    operand.kind = KIND_UNDEFINED;
+                }
+            } else if (operand.kind == KIND_VALUE) {
+                // arrays only have indices, even "length" is undefined for them
+                if (!key.toString().isEmpty() && key.toString()[0].isDigit()) {
+                    return false;
+                }
+                operand.kind = KIND_UNDEFINED;
+            } else if (operand.kind == KIND_STRING && key.toString() == "length") {
+                operand.kind = KIND_NUMBER;
+                operand.number = operand.string.size();
+            } else {
+                // properties of primitives are functions or throw
+                return false;
+            }
+            break;
+        }
+        case OP_INDEX: {
+            Operand& operand = stack[top];
+            if (operand.kind != KIND_VALUE || !operand.value->isArray()) {
+                return false;
+            }
+
+            const Value& array = *operand.value;
+            int i = instruction.arg;
+            if (i >= array.size()) {
+                operand.kind = KIND_UNDEFINED;
+            } else if (array.getPackedType() != Value::TYPE_UNDEFINED) {
+                load(array.at(i), operand);
+            } else {
+                load(array[i], operand);
+            }
+            break;
+        }
+        case OP_NOT: {
+            Operand& operand = stack[top];
+            operand.boolean = !toBoolean(operand);
+            operand.kind = KIND_BOOLEAN;
+            break;
+        }
+        case OP_NEGATE:
+        case OP_PLUS: {
+            Operand& operand = stack[top];
+            if (operand.kind == KIND_VALUE) {
+                return false;
+            }
+            operand.number = instruction.op == OP_NEGATE ? -toNumber(operand) : toNumber(operand);
+            operand.kind = KIND_NUMBER;
+            break;
+        }
+        case OP_ADD:
+        case OP_SUBTRACT:
+        case OP_MULTIPLY:
+        case OP_DIVIDE:
+        case OP_MODULO: {
+            Operand& b = stack[top--];
+            Operand& a = stack[top];
+            if (a.kind == KIND_VALUE || b.kind == KIND_VALUE) {
+                return false;
+            }
+
+            if (instruction.op == OP_ADD && (a.kind == KIND_STRING || b.kind == KIND_STRING)) {
+                // converting numbers to strings follows rules of its own, only strings are concatenated here
+                if (a.kind != KIND_STRING || b.kind != KIND_STRING) {
+                    return false;
+                }
+                a.string += b.string;
+                break;
+            }
+
+            double x = toNumber(a);
+            double y = toNumber(b);
+            switch (instruction.op) {
+            case OP_ADD:
+                a.number = x + y;
+                break;
+            case OP_SUBTRACT:
+                a.number = x - y;
+                break;
+            case OP_MULTIPLY:
+                a.number = x * y;
+                break;
+            case OP_DIVIDE:
+                a.number = x / y;
+                break;
+            default:
+                a.number = std::fmod(x, y);
+                break;
+            }
+            a.kind = KIND_NUMBER;
+            break;
+        }
+        case OP_EQUAL:
+        case OP_NOT_EQUAL:
+        case OP_STRICT_EQUAL:
+        case OP_STRICT_NOT_EQUAL: {
+            Operand& b = stack[top--];
+            Operand& a = stack[top];
+            bool equal;
+            bool strict = instruction.op == OP_STRICT_EQUAL || instruction.op == OP_STRICT_NOT_EQUAL;
+            if (!(strict ? strictEquals(a, b, equal) : looseEquals(a, b, equal))) {
+                return false;
+            }
+            a.boolean = (instruction.op == OP_EQUAL || instruction.op == OP_STRICT_EQUAL) ? equal : !equal;
+            a.kind = KIND_BOOLEAN;
+            break;
+        }
+        case OP_LESS:
+        case OP_LESS_EQUAL:
+        case OP_GREATER:
+        case OP_GREATER_EQUAL: {
+            Operand& b = stack[top--];
+            Operand& a = stack[top];
+            if (a.kind == KIND_VALUE || b.kind == KIND_VALUE) {
+                return false;
+            }
+
+            int c = compare(a, b);
+            switch (instruction.op) {
+            case OP_LESS:
+                a.boolean = c == -1;
+                break;
+            case OP_LESS_EQUAL:
+                a.boolean = c == -1 || c == 0;
+                break;
+            case OP_GREATER:
+                a.boolean = c == 1;
+                break;
+            default:
+                a.boolean = c == 1 || c == 0;
+                break;
+            }
+            a.kind = KIND_BOOLEAN;
+            break;
+        }
+        case OP_AND:
+            // like in scripts the deciding operand is the result, not a boolean
+            if (!toBoolean(stack[top])) {
+                pc = instruction.arg;
+            } else {
+                top--;
+            }
+            break;
+        case OP_OR:
+            if (toBoolean(stack[top])) {
+                pc = instruction.arg;
+            } else {
+                top--;
+            }
+            break;
+        case OP_JUMP:
+            pc = instruction.arg;
+            break;
+        case OP_JUMP_IF_FALSE:
+            if (!toBoolean(stack[top--])) {
+                pc = instruction.arg;
+            }
+            break;
+        }
+    }
+
+    const Operand& operand = stack[top];
+    switch (operand.kind) {
+    case KIND_NULL:
+        result.null();
+        break;
+    case KIND_BOOLEAN:
+        result = operand.boolean;
+        break;
+    case KIND_NUMBER:
+        result = operand.number;
+        break;
+    case KIND_STRING:
+        result = operand.string;
+        break;
+    case KIND_VALUE:
+        result = *operand.value;
+        break;
+    default:
+        result.undefined();
+        break;
+    }
+
+    return true;
+}
+
+QList<ValuePath> Expression::getPaths() const {
+    QList<ValuePath> paths;
+    QStringList strings;
+    for (int i = 0; i < program.size(); i++) {
+        QString path;
+        if (program[i].op == OP_INPUT) {
+            path = "input";
+        } else if (program[i].op == OP_OUTPUT) {
+            path = "output";
+        } else if (program[i].op == OP_EVENT) {
+            path = "event";
+        } else {
+            continue;
+        }
+        for (; i + 1 < program.size(); i++) {
+            const Instruction& instruction = program[i + 1];
+            if (instruction.op == OP_KEY) {
+                path += "." + keys[instruction.arg].toString();
+            } else if (instruction.op == OP_INDEX) {
+                path += QString("[%1]").arg(instruction.arg);
+            } else {
+                break;
+            }
+        }
+
+        if (!strings.contains(path)) {
+            strings.append(path);
+            paths.append(ValuePath(path));
+        }
+    }
+
+    return paths;
+}
+
+bool Expression::isValid() const {
+    return valid;
+}
+
+const QString& Expression::getError() const {
+    return error;
+}
+
+void Expression::next() {
+    while (pos < source.size() && source[pos].isSpace()) {
+        pos++;
+    }
+
+    text.clear();
+    if (pos >= source.size()) {
+        token = TOKEN_END;
+
+        return;
+    }
+
+    QChar c = source[pos];
+    int start = pos;
+
+    // numbers
+    if (c.isDigit() || (c == '.' && pos + 1 < source.size() && source[pos + 1].isDigit())) {
+        bool ok = true;
+        if (c == '0' && pos + 1 < source.size() && (source[pos + 1] == 'x' || source[pos + 1] == 'X')) {
+            pos += 2;
+            while (pos < source.size() && (source[pos].isDigit() || (source[pos].toLower() >= 'a' && source[pos].toLower() <= 'f'))) {
+                pos++;
+            }
+            number = source.mid(start + 2, pos - start - 2).toULongLong(&ok, 16);
+        } else if (c == '0' && pos + 1 < source.size() && source[pos + 1].isDigit()) {
+            // octal literals
+            ok = false;
+            pos++;
+        } else {
+            while (pos < source.size() && source[pos].isDigit()) {
+                pos++;
+            }
+            if (pos < source.size() && source[pos] == '.') {
+                pos++;
+                while (pos < source.size() && source[pos].isDigit()) {
+                    pos++;
+                }
+            }
+            if (pos < source.size() && (source[pos] == 'e' || source[pos] == 'E')) {
+                pos++;
+                if (pos < source.size() && (source[pos] == '+' || source[pos] == '-')) {
+                    pos++;
+                }
+                while (pos < source.size() && source[pos].isDigit()) {
+                    pos++;
+                }
+            }
+            number = source.mid(start, pos - start).toDouble(&ok);
+        }
+
+        text = source.mid(start, pos - start);
+        if (!ok || (pos < source.size() && (source[pos].isLetterOrNumber() || source[pos] == '_' || source[pos] == '$'))) {
+            token = TOKEN_INVALID;
+        } else {
+            token = TOKEN_NUMBER;
+        }
+
+        return;
+    }
+
+    // strings
+    if (c == '"' || c == '\'') {
+        pos++;
+        while (pos < source.size() && source[pos] != c) {
+            QChar ch = source[pos++];
+            if (ch == '\\' && pos < source.size()) {
+                QChar escaped = source[pos++];
+                switch (escaped.unicode()) {
+                case 'n':
+                    text += '\n';
+                    break;
+                case 't':
+                    text += '\t';
+                    break;
+                case 'r':
+                    text += '\r';
+                    break;
+                case '\\':
+                case '\'':
+                case '"':
+                    text += escaped;
+                    break;
+                default:
+                    token = TOKEN_INVALID;
+
+                    return;
+                }
+            } else if (ch == '\n') {
+                token = TOKEN_INVALID;
+
+                return;
+            } else {
+                text += ch;
+            }
+        }
+
+        if (pos >= source.size()) {
+            token = TOKEN_INVALID;
+
+            return;
+        }
+
+        pos++;
+        token = TOKEN_STRING;
+
+        return;
+    }
+
+    // identifiers
+    if (c.isLetter() || c == '_' || c == '$') {
+        while (pos < source.size() && (source[pos].isLetterOrNumber() || source[pos] == '_' || source[pos] == '$')) {
+            pos++;
+        }
+        text = source.mid(start, pos - start);
+        token = TOKEN_IDENTIFIER;
+
+        return;
+    }
+
+    // punctuators, longest match first
+    static const char* punctuators[] = {"===", "!==", "==", "!=", "<=", ">=", "&&", "||", "++", "--",
+                                        "+", "-", "*", "/", "%", "<", ">", "!", "(", ")", "[", "]", ".", "?", ":"};
+    for (unsigned int i = 0; i < sizeof(punctuators) / sizeof(punctuators[0]); i++) {
+        QLatin1String punctuator(punctuators[i]);
+        if (source.midRef(pos, punctuator.size()) == punctuator) {
+            pos += punctuator.size();
+            text = punctuator;
+            // increments and decrements change variables
+            token = (text == "++" || text == "--") ? TOKEN_INVALID : TOKEN_PUNCTUATOR;
+
+            return;
+        }
+    }
+
+    pos++;
+    text = c;
+    token = TOKEN_INVALID;
+}
+
+int Expression::write(OpCode op, int arg) {
+    Instruction instruction;
+    instruction.op = op;
+    instruction.arg = arg;
+    program.append(instruction);
+
+    switch (op) {
+    case OP_PUSH:
+    case OP_INPUT:
+    case OP_OUTPUT:
+    case OP_EVENT:
+        depth++;
+        break;
+    case OP_KEY:
+    case OP_INDEX:
+    case OP_NOT:
+    case OP_NEGATE:
+    case OP_PLUS:
+    case OP_JUMP:
+        break;
+    default:
+        // binary operators and conditional jumps, which pop an operand on the path falling through
+        depth--;
+        break;
+    }
+    maxDepth = qMax(maxDepth, depth);
+
+    return program.size() - 1;
+}
+
+bool Expression::fail(const QString& message) {
+    if (error.isEmpty()) {
+        error = QString("%1 at column %2").arg(message).arg(pos);
+    }
+
+    return false;
+}
+
+bool Expression::parseConditional() {
+    if (!parseBinary(1)) {
+        return false;
+    }
+
+    if (token != TOKEN_PUNCTUATOR || text != "?") {
+        return true;
+    }
+    next();
+
+    int jumpElse = write(OP_JUMP_IF_FALSE, -1);
+    if (!parseConditional()) {
+        return false;
+    }
+
+    if (token != TOKEN_PUNCTUATOR || text != ":") {
+        return fail("expected \":\"");
+    }
+    next();
+
+    int jumpEnd = write(OP_JUMP, -1);
+    // the else branch starts without the value of the then branch
+    depth--;
+    program[jumpElse].arg = program.size();
+    if (!parseConditional()) {
+        return false;
+    }
+    program[jumpEnd].arg = program.size();
+
+    return true;
+}
+
+bool Expression::parseBinary(int precedence) {
+    static const struct {
+        const char* text;
+        int precedence;
+        OpCode op;
+    } operators[] = {
+        {"||", 1, OP_OR},
+        {"&&", 2, OP_AND},
+        {"==", 3, OP_EQUAL},
+        {"!=", 3, OP_NOT_EQUAL},
+        {"===", 3, OP_STRICT_EQUAL},
+        {"!==", 3, OP_STRICT_NOT_EQUAL},
+        {"<", 4, OP_LESS},
+        {"<=", 4, OP_LESS_EQUAL},
+        {">", 4, OP_GREATER},
+        {">=", 4, OP_GREATER_EQUAL},
+        {"+", 5, OP_ADD},
+        {"-", 5, OP_SUBTRACT},
+        {"*", 6, OP_MULTIPLY},
+        {"/", 6, OP_DIVIDE},
+        {"%", 6, OP_MODULO}
+    };
+
+    if (!parseUnary()) {
+        return false;
+    }
+
+    while (token == TOKEN_PUNCTUATOR) {
+        int i = 0;
+        int count = sizeof(operators) / sizeof(operators[0]);
+        while (i < count && text != QLatin1String(operators[i].text)) {
+            i++;
+        }
+
+        if (i == count || operators[i].precedence < precedence) {
+            return true;
+        }
+        next();
+
+        // all binary operators are left associative
+        if (operators[i].op == OP_AND || operators[i].op == OP_OR) {
+            int jump = write(operators[i].op, -1);
+            if (!parseBinary(operators[i].precedence + 1)) {
+                return false;
+            }
+            program[jump].arg = program.size();
+        } else {
+            if (!parseBinary(operators[i].precedence + 1)) {
+                return false;
+            }
+            write(operators[i].op);
+        }
+    }
+
+    return true;
+}
+
+bool Expression::parseUnary() {
+    if (token == TOKEN_PUNCTUATOR && (text == "!" || text == "-" || text == "+")) {
+        OpCode op = text == "!" ? OP_NOT : (text == "-" ? OP_NEGATE : OP_PLUS);
+        next();
+        if (!parseUnary()) {
+            return false;
+        }
+        write(op);
+
+        return true;
+    }
+
+    return parsePostfix();
+}
+
+bool Expression::parsePrimary() {
+    if (token == TOKEN_NUMBER) {
+        constants.append(Value(number));
+        write(OP_PUSH, constants.size() - 1);
+    } else if (token == TOKEN_STRING) {
+        constants.append(Value(text));
+        write(OP_PUSH, constants.size() - 1);
+    } else if (token == TOKEN_IDENTIFIER) {
+        if (text == "input") {
+            write(OP_INPUT);
+        } else if (text == "output") {
+            write(OP_OUTPUT);
+        } else if (text == "event") {
+            write(OP_EVENT);
+        } else if (text == "true" || text == "false") {
+            constants.append(Value(text == "true"));
+            write(OP_PUSH, constants.size() - 1);
+        } else if (text == "null") {
+            constants.append(Value());
+            write(OP_PUSH, constants.size() - 1);
+        } else if (text == "undefined") {
+            Value undefined;
+            undefined.undefined();
+            constants.append(undefined);
+            write(OP_PUSH, constants.size() - 1);
+        } else {
+            return fail(QString("unsupported identifier \"%1\"").arg(text));
+        }
+    } else if (token == TOKEN_PUNCTUATOR && text == "(") {
+        next();
+        if (!parseConditional()) {
+            return false;
+        }
+
+        if (token != TOKEN_PUNCTUATOR || text != ")") {
+            return fail("expected \")\"");
+        }
+    } else if (token == TOKEN_END) {
+        return fail("unexpected end");
+    } else {
+        return fail(QString("unexpected \"%1\"").arg(text));
+    }
+
+    next();
+
+    return true;
+}
+
+bool Expression::parsePostfix() {
+    if (!parsePrimary()) {
+        return false;
+    }
+
+    while (token == TOKEN_PUNCTUATOR && (text == "." || text == "[")) {
+        bool member = text == ".";
+        next();
+
+        if (member && token != TOKEN_IDENTIFIER) {
+            return fail("expected property name");
+        } else if (!member && token == TOKEN_NUMBER) {
+            if (number < 0 || number > 0x7fffffff || number != std::floor(number)) {
+                return fail(QString("unsupported index \"%1\"").arg(text));
+            }
+            write(OP_INDEX, static_cast<int>(number));
+        } else if (!member && token != TOKEN_STRING) {
+            return fail("unsupported computed property");
+        }
+
+        if (member || token == TOKEN_STRING) {
+            // the script binding leaves these to the script engine, they are functions
+            if (text == "toString" || text == "valueOf") {
+                return fail(QString("unsupported property \"%1\"").arg(text));
+            }
+            keys.append(ValueKey(text));
+            write(OP_KEY, keys.size() - 1);
+        }
+        next();
+
+        if (!member) {
+            if (token != TOKEN_PUNCTUATOR || text != "]") {
+                return fail("expected \"]\"");
+            }
+            next();
+        }
+    }
+
+    return true;
+}
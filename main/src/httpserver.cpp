@@ -25,7 +25,8 @@ using namespace hfsmexec;
 PushNotification::PushNotification(int maxQueueSize, int maxReadSize) :
     pos(0),
     maxQueueSize(maxQueueSize),
-    maxReadSize(maxReadSize) {
+    maxReadSize(maxReadSize),
+    readers(0) {
 
 }
 
@@ -52,6 +53,25 @@ void PushNotification::write(const std::string& data) {
 }
 
 bool PushNotification::read(int& pos, std::string& data, int timeout) {
+    std::vector<std::string> messages;
+    if (!read(pos, messages, timeout)) {
+        return false;
+    }
+
+    data.append("[");
+    for (unsigned int i = 0; i < messages.size(); i++) {
+        if (i > 0) {
+            data.append(", ");
+        }
+
+        data.append(messages[i]);
+    }
+    data.append("]");
+
+    return true;
+}
+
+bool PushNotification::read(int& pos, std::vector<std::string>& data, int timeout) {
     // set pos to buffer end, if pos <= 0
     if (pos <= 0) {
         pos = this->pos + 1;
@@ -59,7 +79,11 @@ bool PushNotification::read(int& pos, std::string& data, int timeout) {
 
     // wait till message at buffer pos is available
     std::unique_lock<std::mutex> conditionLock(lock);
-    if (!condition.wait_for(conditionLock, std::chrono::seconds(timeout), [&] {return pos <= this->pos || this->pos == -1;})) {
+    readers++;
+    bool available = condition.wait_for(conditionLock, std::chrono::seconds(timeout), [&] {return pos <= this->pos || this->pos == -1;});
+    readers--;
+    lastRead = std::chrono::steady_clock::now();
+    if (!available) {
         return false;
     }
 
@@ -78,16 +102,10 @@ bool PushNotification::read(int& pos, std::string& data, int timeout) {
     }
 
     // read all available buffer from pos (max
-    data.append("[");
     int bufferEnd = this->pos;
     for (int i = 0; pos <= bufferEnd && i < maxReadSize; i++, pos++) {
-        if (i > 0) {
-            data.append(", ");
-        }
-
-        data.append(buffer[pos]);
+        data.push_back(buffer[pos]);
     }
-    data.append("]");
 
     conditionLock.unlock();
     condition.notify_all();
@@ -100,6 +118,13 @@ void PushNotification::unlock() {
     condition.notify_all();
 }
 
+bool PushNotification::isSubscribed() {
+    std::lock_guard<std::mutex> scopedLock(lock);
+
+    // clients poll again right after a read, a client counts as subscribed for a minute after its last read
+    return readers > 0 || (lastRead != std::chrono::steady_clock::time_point() && std::chrono::steady_clock::now() - lastRead < std::chrono::seconds(60));
+}
+
 /*
  * HttpRequest
  */
@@ -285,7 +310,8 @@ int HttpServer::requestHandler(void* cls, struct MHD_Connection* connection, con
 
     // process upload data
     if (*uploadDataSize != 0) {
-        context->request->body = uploadData;
+        // the body might be binary and arrive in several chunks
+        context->request->body.append(uploadData, *uploadDataSize);
         *uploadDataSize = 0;
 
         return MHD_YES;
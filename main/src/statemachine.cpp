@@ -17,9 +17,14 @@
 
 #include <statemachine.h>
 #include <application.h>
+#include <engine.h>
+#include <topology.h>
 
 #include <QUuid>
+#include <QMutexLocker>
+#include <QReadWriteLock>
 #include <QScriptEngine>
+#include <QStringList>
 
 using namespace hfsmexec;
 
@@ -33,6 +38,47 @@ AbstractEvent::AbstractEvent(Type type) :
 
 }
 
+// event ids are never released, names are only interned by the transitions and states waiting for them so events
+// received from clients can't grow the table, an event without an interned name gets id 0 and matches no transition
+static QHash<QString, int> eventIds;
+static QVector<QString> eventNames;
+static QReadWriteLock eventLock;
+
+int AbstractEvent::internEventName(const QString& eventName) {
+    eventLock.lockForRead();
+    QHash<QString, int>::const_iterator it = eventIds.constFind(eventName);
+    if (it != eventIds.constEnd()) {
+        int eventId = it.value();
+        eventLock.unlock();
+
+        return eventId;
+    }
+    eventLock.unlock();
+
+    eventLock.lockForWrite();
+    int& eventId = eventIds[eventName];
+    if (eventId == 0) {
+        eventNames.append(eventName);
+        eventId = eventNames.size();
+    }
+    int interned = eventId;
+    eventLock.unlock();
+
+    return interned;
+}
+
+int AbstractEvent::findEventName(const QString& eventName) {
+    QReadLocker locker(&eventLock);
+
+    return eventIds.value(eventName, 0);
+}
+
+QString AbstractEvent::lookupEventName(int eventId) {
+    QReadLocker locker(&eventLock);
+
+    return eventId > 0 && eventId <= eventNames.size() ? eventNames[eventId - 1] : QString();
+}
+
 /*
  * AbstractTransition
  */
@@ -102,9 +148,25 @@ bool AbstractTransition::initialize() {
 /*
  * Assign
  */
+const Logger* Assign::logger = Logger::getLogger(LOGGER_STATEMACHINE);
+
 Assign::Assign(const QString& from, const QString& to) :
     from(from),
-    to(to) {
+    to(to),
+    fromPath(from),
+    toPath(to),
+    stateMachine(NULL),
+    transformation(false),
+    evaluated(false) {
+    // anything which can't be part of a path makes "from" an expression, e.g. "output.velocity * 0.001". The event
+    // only exists while a transition is taken, so it is read like an expression as well.
+    transformation = from == "event" || from.startsWith("event.") || from.startsWith("event[");
+    for (int i = 0; i < from.size() && !transformation; i++) {
+        transformation = from[i].isSpace() || QString("+*/%!?:<>=&|()'\",").contains(from[i]);
+    }
+}
+
+Assign::~Assign() {
 
 }
 
@@ -116,6 +178,132 @@ const QString& Assign::getTo() const {
     return to;
 }
 
+const ValuePath& Assign::getFromPath() const {
+    return fromPath;
+}
+
+const ValuePath& Assign::getToPath() const {
+    return toPath;
+}
+
+bool Assign::isTransformation() const {
+    return transformation;
+}
+
+static const Value& resolve(const Value& input, const Value& output, const Value& event, const ValuePath& path) {
+    static const ValueKey inputKey("input");
+    static const ValueKey outputKey("output");
+
+    const Value* value = path[0].key == inputKey ? &input : path[0].key == outputKey ? &output : &event;
+    for (int i = 1; i < path.size() && value->isValid(); i++) {
+        const ValuePath::Segment& segment = path[i];
+        if (segment.index >= 0 && value->isArray()) {
+            value = &(*value)[segment.index];
+        } else if (segment.index < 0 && value->isObject()) {
+            value = &(*value)[segment.key];
+        } else {
+            // properties of strings, like "length", change with the string itself
+            break;
+        }
+    }
+
+    return *value;
+}
+
+bool Assign::evaluate(AbstractState* sourceState, Value& event, Value& result) {
+    const Value& input = sourceState->getInput();
+    const Value& output = sourceState->getOutput();
+
+    if (expression.isValid()) {
+        // the expression is only evaluated again if one of the values it reads has changed since the last time
+        bool changed = !evaluated;
+        for (int i = 0; i < dependencies.size(); i++) {
+            const Value& value = resolve(input, output, event, dependencies[i]);
+            const Value& argument = arguments[i];
+            bool equal = value.isValid() ? (value.getType() == argument.getType() && (value.isNull() || value.isUndefined() || value == argument)) : argument.isUndefined();
+            if (!equal) {
+                if (value.isValid()) {
+                    arguments[i] = value;
+                } else {
+                    arguments[i].undefined();
+                }
+                changed = true;
+            }
+        }
+
+        if (!changed) {
+            result = this->result;
+
+            return true;
+        }
+
+        if (expression.evaluate(input, output, event, this->result)) {
+            evaluated = true;
+            result = this->result;
+
+            return true;
+        }
+
+        evaluated = false;
+    }
+
+    QScriptEngine* scriptEngine = stateMachine->getScriptEngine();
+    QScriptContext* context = scriptEngine->pushContext();
+
+    context->activationObject().setProperty("input", ValueScriptBinding::create(scriptEngine, &sourceState->getInput()));
+    context->activationObject().setProperty("output", ValueScriptBinding::create(scriptEngine, &sourceState->getOutput()));
+    context->activationObject().setProperty("event", ValueScriptBinding::create(scriptEngine, &event));
+
+    QScriptValue value = scriptEngine->evaluate(program);
+    bool success = !scriptEngine->hasUncaughtException();
+    if (!success) {
+        logger->warning(QString("%1 couldn't evaluate transformation: %2").arg(toString()).arg(value.toString()));
+        scriptEngine->clearExceptions();
+    } else if (value.isBool()) {
+        result = value.toBool();
+    } else if (value.isNumber()) {
+        result = value.toNumber();
+    } else if (value.isString()) {
+        result = value.toString();
+    } else if (value.isNull()) {
+        result.null();
+    } else if (ValueScriptBinding::getValue(value) != NULL) {
+        result = *ValueScriptBinding::getValue(value);
+    } else {
+        logger->warning(QString("%1 couldn't evaluate transformation: unsupported result %2").arg(toString()).arg(value.toString()));
+        success = false;
+    }
+
+    scriptEngine->popContext();
+
+    return success;
+}
+
+bool Assign::initialize() {
+    if (!transformation) {
+        return true;
+    }
+
+    QScriptSyntaxCheckResult syntax = QScriptEngine::checkSyntax(from);
+    if (syntax.state() != QScriptSyntaxCheckResult::Valid) {
+        logger->warning(QString("%1 initialization failed: invalid expression: %2 (column %3)").arg(toString()).arg(syntax.errorMessage()).arg(syntax.errorColumnNumber()));
+
+        return false;
+    }
+
+    if (expression.compile(from)) {
+        dependencies = expression.getPaths();
+        arguments.resize(dependencies.size());
+    } else {
+        logger->info(QString("%1 transformation is evaluated with QtScript: %2").arg(toString()).arg(expression.getError()));
+    }
+
+    program = QScriptProgram(from, to);
+    evaluated = false;
+
+    return true;
+}
+
 QString Assign::toString() const {
     return QString("[Assign: from=%1, toId=%2]").arg(from).arg(to);
 }
@@ -161,6 +349,28 @@ StateMachine* Dataflow::getStateMachine() {
     return stateMachine;
 }
 
+void Dataflow::apply() {
+    // assigned paths are linked once by the builder, only transformations have to be evaluated
+    Value targetParameters;
+    for (int i = 0; i < assigns.size(); i++) {
+        Assign* assign = assigns[i];
+        if (!assign->isTransformation()) {
+            continue;
+        }
+
+        Value result;
+        if (!assign->evaluate(sourceState, stateMachine->getEventPayload(), result) || result.isUndefined()) {
+            continue;
+        }
+
+        if (targetParameters.isNull()) {
+            targetParameters["input"] = &targetState->getInput();
+            targetParameters["output"] = &targetState->getOutput();
+        }
+        targetParameters.getValue(assign->getToPath()) = result;
+    }
+}
+
 QString Dataflow::toString() const {
     return QString("[Dataflow: sourceId=%1, targetId=%2]").arg(sourceStateId).arg(targetStateId);
 }
@@ -238,6 +448,10 @@ const QList<AbstractState*>& AbstractState::getChildStates() const {
 }
 
 AbstractState* AbstractState::getChildState(const QString& stateId) {
+    if (stateMachine != NULL) {
+        return stateMachine->getChildState(this, stateId);
+    }
+
     for (int i = 0; i < childStates.size(); i++) {
         if (childStates[i]->getId() == stateId) {
             return childStates[i];
@@ -252,6 +466,10 @@ const QList<AbstractTransition*>& AbstractState::getTransitions() const {
 }
 
 AbstractTransition* AbstractState::getTransition(const QString& transitionId) {
+    if (stateMachine != NULL) {
+        return stateMachine->getTransition(this, transitionId);
+    }
+
     for (int i = 0; i < transitions.size(); i++) {
         if (transitions[i]->getId() == transitionId) {
             return transitions[i];
@@ -266,6 +484,12 @@ AbstractState* AbstractState::findState(const QString& stateId) {
         return this;
     }
 
+    // use the index of a built state machine
+    const StateMachineTopology* topology = stateMachine != NULL ? stateMachine->getTopology() : NULL;
+    if (topology != NULL && topology->indexOf(this) >= 0) {
+        return topology->findState(this, stateId);
+    }
+
     // find state recursively
     for (int i = 0; i < childStates.size(); i++) {
         AbstractState* state = childStates[i]->findState(stateId);
@@ -283,7 +507,8 @@ AbstractState* AbstractState::findState(const QString& stateId) {
 AbstractComplexState::AbstractComplexState(const QString &stateId, const QString& parentStateId) :
     AbstractState(stateId, parentStateId),
     delegate(new QState()),
-    active(false) {
+    active(false),
+    finishEventId(AbstractEvent::internEventName("finish." + uuid)) {
     // connect signals
     connect(delegate, SIGNAL(entered()), this, SLOT(eventEnter()));
     connect(delegate, SIGNAL(exited()), this, SLOT(eventExit()));
@@ -322,6 +547,10 @@ void AbstractComplexState::eventEnter() {
 
     active = true;
 
+    for (int i = 0; i < dataflows.size(); i++) {
+        dataflows[i]->apply();
+    }
+
     Value value;
     value["action"] = "state";
     value["id"] = stateId;
@@ -348,7 +577,7 @@ void AbstractComplexState::eventFinish() {
 
     active = false;
 
-    NamedEvent* event = new NamedEvent("finish." + uuid);
+    NamedEvent* event = new NamedEvent(finishEventId);
     stateMachine->postEvent(event);
 
     Value value;
@@ -366,19 +595,32 @@ const QEvent::Type NamedEvent::type = QEvent::Type(QEvent::User + 1);
 
 NamedEvent::NamedEvent(const QString &name) :
     AbstractEvent(type),
+    eventId(findEventName(name)),
     eventName(name) {
 
 }
 
+NamedEvent::NamedEvent(int eventId) :
+    AbstractEvent(type),
+    eventId(eventId),
+    eventName(lookupEventName(eventId)) {
+
+}
+
 NamedEvent::~NamedEvent() {
 
 }
 
+int NamedEvent::getEventId() const {
+    return eventId;
+}
+
 const QString& NamedEvent::getEventName() const {
     return eventName;
 }
 
 void NamedEvent::setEventName(const QString& name) {
+    this->eventId = findEventName(name);
     this->eventName = name;
 }
 
@@ -398,6 +640,18 @@ void NamedEvent::setMessage(const QString& message) {
     this->message = message;
 }
 
+Value& NamedEvent::getPayload() {
+    return payload;
+}
+
+const Value& NamedEvent::getPayload() const {
+    return payload;
+}
+
+void NamedEvent::setPayload(const Value& payload) {
+    this->payload = payload;
+}
+
 QString NamedEvent::toString() const {
     return QString("[NamedEvent: eventName=%1]").arg(eventName);
 }
@@ -407,11 +661,20 @@ QString NamedEvent::toString() const {
  */
 ConditionalTransition::ConditionalTransition(const QString& transitionId, const QString& sourceStateId, const QString& targetStateId, const QString& eventName, QString condition) :
     AbstractTransition(transitionId, sourceStateId, targetStateId),
+    eventId(0),
     eventName(eventName),
     condition(condition) {
 
 }
 
+int ConditionalTransition::getEventId() const {
+    return eventId;
+}
+
+const QString& ConditionalTransition::getEventName() const {
+    return eventName;
+}
+
 bool ConditionalTransition::initialize() {
     if (!AbstractTransition::initialize()) {
         return false;
@@ -421,6 +684,27 @@ bool ConditionalTransition::initialize() {
         eventName = eventName + "." + sourceState->getUuid();
     }
 
+    // events are matched by id, the state machine indexes its transitions by the events they are waiting for
+    eventId = AbstractEvent::internEventName(eventName);
+    stateMachine->eventTransitions[eventId].append(this);
+
+    // the condition is parsed once here instead of on every tested event
+    if (!condition.isEmpty()) {
+        QScriptSyntaxCheckResult syntax = QScriptEngine::checkSyntax(condition);
+        if (syntax.state() != QScriptSyntaxCheckResult::Valid) {
+            logger->warning(QString("%1 transition initialization failed: invalid condition \"%2\": %3 (column %4)").arg(toString()).arg(condition).arg(syntax.errorMessage()).arg(syntax.errorColumnNumber()));
+
+            return false;
+        }
+
+        // simple conditions are evaluated natively, QtScript is only needed for everything else
+        if (!expression.compile(condition)) {
+            logger->info(QString("%1 condition is evaluated with QtScript: %2").arg(toString()).arg(expression.getError()));
+        }
+
+        program = QScriptProgram(condition, transitionId);
+    }
+
     return true;
 }
 
@@ -435,22 +719,37 @@ bool ConditionalTransition::eventTest(QEvent* e) {
 
     NamedEvent* namedEvent = static_cast<NamedEvent*>(e);
 
-    if (namedEvent->getEventName() != eventName) {
+    if (namedEvent->getEventId() != eventId) {
         return false;
     }
 
     if (!condition.isEmpty()) {
+        bool result;
+        if (expression.evaluate(sourceState->getInput(), sourceState->getOutput(), namedEvent->getPayload(), result)) {
+            return result;
+        }
+
         QScriptEngine* scriptEngine = stateMachine->getScriptEngine();
         QScriptContext* context = scriptEngine->pushContext();
 
-        context->activationObject().setProperty("input", ValueScriptBinding::create(scriptEngine, &sourceState->getInput())); // TODO performance?
-        context->activationObject().setProperty("output", ValueScriptBinding::create(scriptEngine, &sourceState->getOutput())); // TODO performance?
+        context->activationObject().setProperty("input", ValueScriptBinding::create(scriptEngine, &sourceState->getInput()));
+        context->activationObject().setProperty("output", ValueScriptBinding::create(scriptEngine, &sourceState->getOutput()));
 
-        bool result = scriptEngine->evaluate(condition).toBool();
+        // wrappers are cached by address, the payload is shared into a member so every event gets the same one
+        eventPayload = namedEvent->getPayload();
+        context->activationObject().setProperty("event", ValueScriptBinding::create(scriptEngine, &eventPayload));
+
+        QScriptValue result = scriptEngine->evaluate(program);
+        bool success = !scriptEngine->hasUncaughtException();
+        if (!success) {
+            logger->warning(QString("%1 couldn't evaluate condition: %2").arg(toString()).arg(result.toString()));
+            scriptEngine->clearExceptions();
+        }
 
         scriptEngine->popContext();
+        eventPayload = Value();
 
-        return result;
+        return success && result.toBool();
     }
 
     return true;
@@ -463,6 +762,9 @@ void ConditionalTransition::onTransition(QEvent* e) {
 
     NamedEvent* namedEvent = static_cast<NamedEvent*>(e);
 
+    // dataflows into the entered states can read the payload, it is shared instead of copied
+    stateMachine->setEventPayload(namedEvent->getPayload());
+
     logger->info(QString("%1 transition on event %2 from state %3 to state %4").arg(toString()).arg(namedEvent->toString()).arg(sourceStateId).arg(targetStateId));
 
     Value value;
@@ -481,14 +783,26 @@ const QEvent::Type InternalEvent::type = QEvent::Type(QEvent::User + 2);
 
 InternalEvent::InternalEvent(const QString& eventName) :
     AbstractEvent(type),
+    eventId(findEventName(eventName)),
     eventName(eventName) {
 
 }
 
+InternalEvent::InternalEvent(int eventId) :
+    AbstractEvent(type),
+    eventId(eventId),
+    eventName(lookupEventName(eventId)) {
+
+}
+
 InternalEvent::~InternalEvent() {
 
 }
 
+int InternalEvent::getEventId() const {
+    return eventId;
+}
+
 const QString& InternalEvent::getEventName() const {
     return eventName;
 }
@@ -501,7 +815,7 @@ QString InternalEvent::toString() const {
  * InternalTransition
  */
 InternalTransition::InternalTransition(const QString& eventName) :
-    eventName(eventName) {
+    eventId(AbstractEvent::internEventName(eventName)) {
 
 }
 
@@ -512,11 +826,11 @@ bool InternalTransition::eventTest(QEvent* e) {
 
     InternalEvent* iternalEvent = static_cast<InternalEvent*>(e);
 
-    return iternalEvent->getEventName() == eventName;
+    return iternalEvent->getEventId() == eventId;
 }
 
 void InternalTransition::onTransition(QEvent* e) {
-
+    stateMachine->setEventPayload(Value());
 }
 
 /*
@@ -605,7 +919,10 @@ InvokeState::InvokeState(const QString& stateId, const QString& binding, const Q
     AbstractComplexState(stateId, parentStateId),
     binding(binding),
     communicationPlugin(Application::getInstance()->getCommunicationPluginLoader().getCommunicationPlugin(binding)),
-    invocationActive(false) {
+    invocationActive(false),
+    successEventId(AbstractEvent::internEventName("invoke.success." + uuid)),
+    errorEventId(AbstractEvent::internEventName("invoke.error." + uuid)),
+    doneEventId(AbstractEvent::internEventName("done." + uuid)) {
     if (communicationPlugin != NULL) {
         communicationPlugin->successCallback = std::bind(&InvokeState::success, this, std::placeholders::_1);
         communicationPlugin->errorCallback = std::bind(&InvokeState::error, this, std::placeholders::_1);
@@ -712,24 +1029,25 @@ void InvokeState::success(const Value& output) {
 
     invocationActive = false;
 
-    QString s;
-    output.toJson(s);
-    logger->warning(s);
-
+    QList<ValuePath> changes;
+    // the output might be part of a message decoded into an arena, keep a copy which outlives it
     if (output.isValid()) {
-        this->output.unite(output);
+        Value result = output;
+        result.promote();
+        this->output.unite(result, &changes);
     }
 
-    QString s2;
-    this->output.toJson(s2);
-    logger->warning(s2);
+    QStringList paths;
+    for (int i = 0; i < changes.size(); i++) {
+        paths.append(changes[i].isEmpty() ? "." : changes[i].toString());
+    }
 
-    logger->info(QString("%1 invocation finished successfully").arg(toString()));
+    logger->info(QString("%1 invocation finished successfully, changed output: [%2]").arg(toString()).arg(paths.join(", ")));
 
-    NamedEvent* event = new NamedEvent("invoke.success." + uuid);
+    NamedEvent* event = new NamedEvent(successEventId);
     stateMachine->postEvent(event);
 
-    InternalEvent* internalEvent = new InternalEvent("done." + uuid);
+    InternalEvent* internalEvent = new InternalEvent(doneEventId);
     stateMachine->postEvent(internalEvent);
 }
 
@@ -746,10 +1064,10 @@ void InvokeState::error(QString message) {
 
     logger->warning(QString("%1 invocation finished with an error: %2").arg(toString()).arg(message));
 
-    NamedEvent* event = new NamedEvent("invoke.error." + uuid);
+    NamedEvent* event = new NamedEvent(errorEventId);
     stateMachine->postEvent(event);
 
-    InternalEvent* internalEvent = new InternalEvent("done." + uuid);
+    InternalEvent* internalEvent = new InternalEvent(doneEventId);
     stateMachine->postEvent(internalEvent);
 }
 
@@ -764,6 +1082,8 @@ StateMachine::StateMachine(const QString& stateId, const QString &initialId, con
     AbstractComplexState(stateId, parentStateId),
     delegate(new QStateMachine()),
     scriptEngine(new QScriptEngine()),
+    engine(NULL),
+    topology(NULL),
     initialId(initialId) {
     delete AbstractComplexState::delegate;
 
@@ -776,6 +1096,8 @@ StateMachine::StateMachine(const QString& stateId, const QString &initialId, con
 StateMachine::~StateMachine() {
     delete delegate; // TODO sometimes tries to delete null pointer
     delete scriptEngine;
+    delete engine;
+    delete topology;
 }
 
 bool StateMachine::isRoot() {
@@ -787,7 +1109,7 @@ bool StateMachine::isRoot() {
 }
 
 void StateMachine::start() const {
-    if (delegate->isRunning()) {
+    if (isRunning()) {
         logger->warning(QString("%1 can't start state machine: state machine is already running").arg(toString()));
 
         return;
@@ -802,11 +1124,15 @@ void StateMachine::start() const {
 
     Application::getInstance()->getApi().pushState(value);
 
-    delegate->start();
+    if (engine != NULL) {
+        engine->start();
+    } else {
+        delegate->start();
+    }
 }
 
 void StateMachine::stop() const {
-    if (!delegate->isRunning()) {
+    if (!isRunning()) {
         logger->warning(QString("%1 can't stop state machine: state machine is not running").arg(toString()));
 
         return;
@@ -814,11 +1140,55 @@ void StateMachine::stop() const {
 
     logger->info(QString("%1 stop state machine").arg(toString()));
 
-    delegate->stop();
+    if (engine != NULL) {
+        engine->stop();
+    } else {
+        delegate->stop();
+    }
+}
+
+bool StateMachine::isRunning() const {
+    return engine != NULL ? engine->isRunning() : delegate->isRunning();
+}
+
+void StateMachine::setNativeEngine(bool enabled) {
+    if (isRunning()) {
+        logger->warning(QString("%1 can't change engine: state machine is running").arg(toString()));
+
+        return;
+    }
+
+    if (enabled && engine == NULL) {
+        logger->info(QString("%1 use native engine").arg(toString()));
+        engine = new StateMachineEngine(this);
+    } else if (!enabled && engine != NULL) {
+        delete engine;
+        engine = NULL;
+    }
+}
+
+StateMachineEngine* StateMachine::getEngine() {
+    return engine;
+}
+
+const StateMachineTopology* StateMachine::getTopology() const {
+    return topology;
+}
+
+AbstractState* StateMachine::getState(const QString& stateId) const {
+    return stateIds.value(stateId, NULL);
+}
+
+AbstractState* StateMachine::getChildState(const AbstractState* parentState, const QString& stateId) const {
+    return childStateIds.value(qMakePair(parentState, stateId), NULL);
+}
+
+AbstractTransition* StateMachine::getTransition(const AbstractState* sourceState, const QString& transitionId) const {
+    return transitionIds.value(qMakePair(sourceState, transitionId), NULL);
 }
 
 int StateMachine::postDelayedEvent(AbstractEvent* event, int delay) {
-    if (!delegate->isRunning()) {
+    if (!isRunning()) {
         logger->warning(QString("%1 can't post delayed event to state machine: state machine is not running").arg(toString()));
 
         return -1;
@@ -826,25 +1196,90 @@ int StateMachine::postDelayedEvent(AbstractEvent* event, int delay) {
 
     logger->info(QString("%1 post delayed event %2").arg(toString()).arg(event->toString()));
 
+    if (engine != NULL) {
+        return engine->postDelayedEvent(event, delay);
+    }
+
     return delegate->postDelayedEvent(event, delay);
 }
 
-void StateMachine::postEvent(AbstractEvent* event, QStateMachine::EventPriority priority) {
-    if (!delegate->isRunning()) {
+bool StateMachine::postEvent(AbstractEvent* event, QStateMachine::EventPriority priority) {
+    if (!isRunning()) {
         logger->warning(QString("%1 can't post event to state machine: state machine is not running").arg(toString()));
+        delete event;
 
-        return;
+        return false;
+    }
+
+    // events no transition is waiting for would only be offered to every active transition in vain
+    if (event->type() == NamedEvent::type && !eventTransitions.contains(static_cast<NamedEvent*>(event)->getEventId())) {
+        logger->info(QString("%1 discard event %2: no transition is waiting for it").arg(toString()).arg(event->toString()));
+        delete event;
+
+        return true;
     }
 
     logger->info(QString("%1 post event %2").arg(toString()).arg(event->toString()));
 
+    if (engine != NULL) {
+        return engine->postEvent(event, priority == QStateMachine::HighPriority);
+    }
+
+    QMutexLocker locker(&postMutex);
     delegate->postEvent(event, priority);
+
+    return true;
+}
+
+bool StateMachine::postEvents(const QList<AbstractEvent*>& events, QStateMachine::EventPriority priority) {
+    if (!isRunning()) {
+        logger->warning(QString("%1 can't post events to state machine: state machine is not running").arg(toString()));
+        qDeleteAll(events);
+
+        return false;
+    }
+
+    QList<AbstractEvent*> waitingEvents;
+    waitingEvents.reserve(events.size());
+    for (int i = 0; i < events.size(); i++) {
+        if (events[i]->type() == NamedEvent::type && !eventTransitions.contains(static_cast<NamedEvent*>(events[i])->getEventId())) {
+            delete events[i];
+        } else {
+            waitingEvents.append(events[i]);
+        }
+    }
+
+    logger->info(QString("%1 post %2 events, %3 discarded: no transition is waiting for them").arg(toString()).arg(waitingEvents.size()).arg(events.size() - waitingEvents.size()));
+
+    if (engine != NULL) {
+        return engine->postEvents(waitingEvents, priority == QStateMachine::HighPriority);
+    }
+
+    // QStateMachine takes one event at a time, the lock keeps the events of other threads out of between
+    QMutexLocker locker(&postMutex);
+    for (int i = 0; i < waitingEvents.size(); i++) {
+        delegate->postEvent(waitingEvents[i], priority);
+    }
+
+    return true;
 }
 
 QScriptEngine* StateMachine::getScriptEngine() {
     return scriptEngine;
 }
 
+Value& StateMachine::getEventPayload() {
+    return eventPayload;
+}
+
+void StateMachine::setEventPayload(const Value& payload) {
+    eventPayload = payload;
+}
+
+const QList<ConditionalTransition*> StateMachine::getEventTransitions(int eventId) const {
+    return eventTransitions.value(eventId);
+}
+
 QStateMachine* StateMachine::getDelegate() const {
     return delegate;
 }
@@ -871,6 +1306,8 @@ QString StateMachine::toString() const {
 
 void StateMachine::eventStart() {
     logger->info(QString("%1 --> started state machine").arg(toString()));
+
+    eventPayload = Value();
 }
 
 void StateMachine::eventStop() {
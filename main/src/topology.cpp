@@ -0,0 +1,238 @@
+/*
+ *  Copyright (C) 2014 Marcel Lehwald
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <topology.h>
+
+#include <algorithm>
+
+using namespace hfsmexec;
+
+/*
+ * StateMachineTopology
+ */
+const Logger* StateMachineTopology::logger = Logger::getLogger(LOGGER_STATEMACHINE);
+
+StateMachineTopology::StateMachineTopology() {
+
+}
+
+StateMachineTopology::~StateMachineTopology() {
+
+}
+
+bool StateMachineTopology::addStates(StateMachine* stateMachine) {
+    states.clear();
+    kinds.clear();
+    parents.clear();
+    depths.clear();
+    ends.clear();
+    initials.clear();
+    indices.clear();
+    ids.clear();
+    transitions.clear();
+    entries.clear();
+    initialEntries.clear();
+
+    add(stateMachine, -1);
+
+    return true;
+}
+
+bool StateMachineTopology::addTransitions() {
+    transitions.clear();
+    entries.clear();
+    initialEntries.clear();
+
+    // initial states are known once the states are initialized
+    QHash<const QAbstractState*, int> delegates;
+    for (int i = 0; i < states.size(); i++) {
+        delegates.insert(states[i]->getDelegate(), i);
+    }
+
+    for (int i = 0; i < states.size(); i++) {
+        if (kinds[i] != KIND_COMPOUND) {
+            continue;
+        }
+
+        QState* delegate = static_cast<QState*>(states[i]->getDelegate());
+        int initial = delegates.value(delegate->initialState(), -1);
+        if (initial <= i || !contains(i, initial)) {
+            logger->warning(QString("%1 has no initial state").arg(states[i]->toString()));
+
+            return false;
+        }
+        initials[i] = initial;
+    }
+
+    // transitions in document order of their source states
+    for (int i = 0; i < states.size(); i++) {
+        const QList<AbstractTransition*>& stateTransitions = states[i]->getTransitions();
+        for (int j = 0; j < stateTransitions.size(); j++) {
+            Transition transition;
+            transition.transition = stateTransitions[j];
+            transition.source = i;
+            transition.target = indexOf(stateTransitions[j]->getTargetState());
+            if (transition.target < 0) {
+                logger->warning(QString("target of %1 is not part of the state machine").arg(transition.transition->toString()));
+
+                return false;
+            }
+
+            // the domain has to be a compound state properly containing both, a transition to an ancestor leaves it
+            int domain = getLca(transition.source, transition.target);
+            if (domain == transition.source || domain == transition.target) {
+                domain = parents[domain];
+            }
+            while (domain >= 0 && kinds[domain] != KIND_COMPOUND) {
+                domain = parents[domain];
+            }
+
+            if (domain < 0) {
+                logger->warning(QString("%1 leaves the state machine").arg(transition.transition->toString()));
+
+                return false;
+            }
+            transition.domain = domain;
+
+            QVector<int> set;
+            addDescendants(transition.target, set);
+            addAncestors(transition.target, transition.domain, set);
+            std::sort(set.begin(), set.end());
+            set.erase(std::unique(set.begin(), set.end()), set.end());
+
+            transition.entryOffset = entries.size();
+            transition.entryCount = set.size();
+            entries += set;
+
+            transitions.append(transition);
+        }
+    }
+
+    addDescendants(0, initialEntries);
+    std::sort(initialEntries.begin(), initialEntries.end());
+    initialEntries.erase(std::unique(initialEntries.begin(), initialEntries.end()), initialEntries.end());
+
+    return true;
+}
+
+int StateMachineTopology::indexOf(const AbstractState* state) const {
+    return indices.value(state, -1);
+}
+
+int StateMachineTopology::getLca(int a, int b) const {
+    while (depths[a] > depths[b]) {
+        a = parents[a];
+    }
+
+    while (depths[b] > depths[a]) {
+        b = parents[b];
+    }
+
+    while (a != b) {
+        a = parents[a];
+        b = parents[b];
+    }
+
+    return a;
+}
+
+AbstractState* StateMachineTopology::findState(const AbstractState* ancestor, const QString& stateId) const {
+    int index = indexOf(ancestor);
+    if (index < 0) {
+        return NULL;
+    }
+
+    // ids aren't unique across the hierarchy, the first descendant in document order is found like a depth first search
+    int found = -1;
+    QMultiHash<QString, int>::const_iterator it = ids.constFind(stateId);
+    for (; it != ids.constEnd() && it.key() == stateId; ++it) {
+        int state = it.value();
+        if (found >= 0 && state > found) {
+            continue;
+        }
+
+        int parent = state;
+        while (depths[parent] > depths[index]) {
+            parent = parents[parent];
+        }
+
+        if (parent == index) {
+            found = state;
+        }
+    }
+
+    return found >= 0 ? states[found] : NULL;
+}
+
+void StateMachineTopology::add(AbstractState* state, int parent) {
+    int index = states.size();
+    states.append(state);
+    parents.append(parent);
+    depths.append(parent >= 0 ? depths[parent] + 1 : 0);
+    ends.append(index + 1);
+    initials.append(-1);
+    indices.insert(state, index);
+    ids.insert(state->getId(), index);
+
+    if (qobject_cast<FinalState*>(state) != NULL) {
+        kinds.append(KIND_FINAL);
+    } else if (qobject_cast<InvokeState*>(state) != NULL) {
+        kinds.append(KIND_INVOKE);
+    } else if (state->getChildStates().isEmpty()) {
+        kinds.append(KIND_ATOMIC);
+    } else if (static_cast<QState*>(state->getDelegate())->childMode() == QState::ParallelStates) {
+        kinds.append(KIND_PARALLEL);
+    } else {
+        kinds.append(KIND_COMPOUND);
+    }
+
+    if (kinds[index] != KIND_FINAL && kinds[index] != KIND_INVOKE) {
+        const QList<AbstractState*>& childStates = state->getChildStates();
+        for (int i = 0; i < childStates.size(); i++) {
+            add(childStates[i], index);
+        }
+    }
+    ends[index] = states.size();
+}
+
+void StateMachineTopology::addDescendants(int state, QVector<int>& set) const {
+    set.append(state);
+
+    if (kinds[state] == KIND_COMPOUND) {
+        addAncestors(initials[state], state, set);
+        addDescendants(initials[state], set);
+    } else if (kinds[state] == KIND_PARALLEL) {
+        for (int child = state + 1; child < ends[state]; child = ends[child]) {
+            addDescendants(child, set);
+        }
+    }
+}
+
+void StateMachineTopology::addAncestors(int state, int ancestor, QVector<int>& set) const {
+    for (int parent = parents[state]; parent != ancestor && parent >= 0; parent = parents[parent]) {
+        set.append(parent);
+
+        // the other regions of a parallel state are entered with their initial states
+        if (kinds[parent] == KIND_PARALLEL) {
+            for (int child = parent + 1; child < ends[parent]; child = ends[child]) {
+                if (!contains(child, state)) {
+                    addDescendants(child, set);
+                }
+            }
+        }
+    }
+}
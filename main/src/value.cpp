@@ -18,83 +18,356 @@
 #include <value.h>
 
 #include <pugixml.hpp>
-#include <json/json.h>
 #include <yaml-cpp/yaml.h>
 
+#include <QHash>
+#include <QReadWriteLock>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define VALUE_JSON_SIMD
+#include <immintrin.h>
+#endif
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <utility>
+
 using namespace hfsmexec;
 
+/*
+ * ArbitraryValueTypeContainer
+ */
+template<typename T>
+struct ArbitraryValueTypeContainer;
+
+template<>
+struct ArbitraryValueTypeContainer<Value::Undefined> {
+    static const Value::Type type = Value::TYPE_UNDEFINED;
+    static const bool inlined = true;
+    static const ArbitraryValue::Packing packing = ArbitraryValue::PACKED_NONE;
+};
+
+template<>
+struct ArbitraryValueTypeContainer<Value::Null> {
+    static const Value::Type type = Value::TYPE_NULL;
+    static const bool inlined = true;
+    static const ArbitraryValue::Packing packing = ArbitraryValue::PACKED_NONE;
+};
+
+template<>
+struct ArbitraryValueTypeContainer<Value::Boolean> {
+    static const Value::Type type = Value::TYPE_BOOLEAN;
+    static const bool inlined = true;
+    static const ArbitraryValue::Packing packing = ArbitraryValue::PACKED_NONE;
+};
+
+template<>
+struct ArbitraryValueTypeContainer<Value::Integer> {
+    static const Value::Type type = Value::TYPE_INTEGER;
+    static const bool inlined = true;
+    static const ArbitraryValue::Packing packing = ArbitraryValue::PACKED_NONE;
+};
+
+template<>
+struct ArbitraryValueTypeContainer<Value::Float> {
+    static const Value::Type type = Value::TYPE_FLOAT;
+    static const bool inlined = true;
+    static const ArbitraryValue::Packing packing = ArbitraryValue::PACKED_NONE;
+};
+
+template<>
+struct ArbitraryValueTypeContainer<Value::String> {
+    static const Value::Type type = Value::TYPE_STRING;
+    static const bool inlined = false;
+    static const ArbitraryValue::Packing packing = ArbitraryValue::PACKED_NONE;
+};
+
+template<>
+struct ArbitraryValueTypeContainer<Value::Array> {
+    static const Value::Type type = Value::TYPE_ARRAY;
+    static const bool inlined = false;
+    static const ArbitraryValue::Packing packing = ArbitraryValue::PACKED_NONE;
+};
+
+template<>
+struct ArbitraryValueTypeContainer<Value::Object> {
+    static const Value::Type type = Value::TYPE_OBJECT;
+    static const bool inlined = false;
+    static const ArbitraryValue::Packing packing = ArbitraryValue::PACKED_NONE;
+};
+
+template<>
+struct ArbitraryValueTypeContainer<Value::IntegerArray> {
+    static const Value::Type type = Value::TYPE_ARRAY;
+    static const bool inlined = false;
+    static const ArbitraryValue::Packing packing = ArbitraryValue::PACKED_INTEGER;
+};
+
+template<>
+struct ArbitraryValueTypeContainer<Value::FloatArray> {
+    static const Value::Type type = Value::TYPE_ARRAY;
+    static const bool inlined = false;
+    static const ArbitraryValue::Packing packing = ArbitraryValue::PACKED_FLOAT;
+};
+
+/*
+ * ValueKey
+ */
+ValueKey::ValueKey() {
+    // the empty atom keeps the reference of this static pointer for the lifetime of the process
+    static Atom* empty = intern(QString());
+    atom = empty;
+    atom->references.ref();
+}
+
+ValueKey::ValueKey(const QString& key) :
+    atom(intern(key)) {
+
+}
+
+ValueKey::ValueKey(const char* key) :
+    atom(intern(QString(key))) {
+
+}
+
+ValueKey::ValueKey(const ValueKey& other) :
+    atom(other.atom) {
+    atom->references.ref();
+}
+
+ValueKey::~ValueKey() {
+    release(atom);
+}
+
+ValueKey& ValueKey::operator=(const ValueKey& other) {
+    if (atom != other.atom) {
+        other.atom->references.ref();
+        release(atom);
+        atom = other.atom;
+    }
+
+    return *this;
+}
+
+int ValueKey::getAtomCount() {
+    QReadLocker locker(&getLock());
+
+    return getAtoms().size();
+}
+
+// atoms are reference counted, a key received from a client is released with the last value using it. The table
+// and its lock are never destroyed, keys in static values may outlive any other static
+QHash<QString, ValueKey::Atom*>& ValueKey::getAtoms() {
+    static QHash<QString, Atom*>* atoms = new QHash<QString, Atom*>();
+
+    return *atoms;
+}
+
+QReadWriteLock& ValueKey::getLock() {
+    static QReadWriteLock* lock = new QReadWriteLock();
+
+    return *lock;
+}
+
+ValueKey::Atom* ValueKey::intern(const QString& key) {
+    QHash<QString, Atom*>& atoms = getAtoms();
+    QReadWriteLock& lock = getLock();
+
+    // references are only added while holding the lock, so an atom can't be found while it is released
+    lock.lockForRead();
+    QHash<QString, Atom*>::const_iterator it = atoms.constFind(key);
+    if (it != atoms.constEnd()) {
+        Atom* atom = it.value();
+        atom->references.ref();
+        lock.unlock();
+
+        return atom;
+    }
+    lock.unlock();
+
+    lock.lockForWrite();
+    Atom*& atom = atoms[key];
+    if (atom == NULL) {
+        atom = new Atom();
+        atom->key = key;
+    }
+    atom->references.ref();
+    Atom* interned = atom;
+    lock.unlock();
+
+    return interned;
+}
+
+void ValueKey::release(Atom* atom) {
+    QHash<QString, Atom*>& atoms = getAtoms();
+    QReadWriteLock& lock = getLock();
+
+    // dropping a reference that isn't the last one doesn't need the lock
+    for (int references = atom->references.load(); references > 1; references = atom->references.load()) {
+        if (atom->references.testAndSetOrdered(references, references - 1)) {
+            return;
+        }
+    }
+
+    lock.lockForWrite();
+    if (!atom->references.deref()) {
+        atoms.remove(atom->key);
+        delete atom;
+    }
+    lock.unlock();
+}
+
 /*
  * Value
  */
 const Logger* Value::logger = Logger::getLogger(LOGGER_VALUE);
 
+const char* Value::typeNames[8] = {"Undefined",
+                                   "Null",
+                                   "Boolean",
+                                   "Integer",
+                                   "Float",
+                                   "String",
+                                   "Array",
+                                   "Object"};
+
 Value::Value() :
-    value(new ArbitraryValue()) {
-    null();
+    type(TYPE_NULL),
+    heap(false) {
+    data.p = NULL;
 }
 
 Value::Value(const Boolean& value) :
-    value(new ArbitraryValue()) {
+    type(TYPE_NULL),
+    heap(false) {
     set(value);
 }
 
 Value::Value(const Integer32& value) :
-    value(new ArbitraryValue()) {
+    type(TYPE_NULL),
+    heap(false) {
     set(value);
 }
 
 Value::Value(const Integer64& value) :
-    value(new ArbitraryValue()) {
+    type(TYPE_NULL),
+    heap(false) {
     set(value);
 }
 
 Value::Value(const Float32& value) :
-    value(new ArbitraryValue()) {
+    type(TYPE_NULL),
+    heap(false) {
     set(value);
 }
 
 Value::Value(const Float64& value) :
-    value(new ArbitraryValue()) {
+    type(TYPE_NULL),
+    heap(false) {
     set(value);
 }
 
 Value::Value(const StringChar& value) :
-    value(new ArbitraryValue()) {
+    type(TYPE_NULL),
+    heap(false) {
     set(value);
 }
 
 Value::Value(const StringStd& value) :
-    value(new ArbitraryValue()) {
+    type(TYPE_NULL),
+    heap(false) {
     set(value);
 }
 
 Value::Value(const String& value) :
-    value(new ArbitraryValue()) {
+    type(TYPE_NULL),
+    heap(false) {
     set(value);
 }
 
 Value::Value(const Array& value) :
-    value(new ArbitraryValue()) {
+    type(TYPE_NULL),
+    heap(false) {
     set(value);
 }
 
 Value::Value(const Object& value) :
-    value(new ArbitraryValue()) {
+    type(TYPE_NULL),
+    heap(false) {
     set(value);
 }
 
-Value::Value(const Value& value) :
-    value(new ArbitraryValue()) {
+Value::Value(const IntegerArray& value) :
+    type(TYPE_NULL),
+    heap(false) {
+    set(value);
+}
+
+Value::Value(const FloatArray& value) :
+    type(TYPE_NULL),
+    heap(false) {
     set(value);
 }
 
+Value::Value(String&& value) :
+    type(TYPE_NULL),
+    heap(false) {
+    set(std::move(value));
+}
+
+Value::Value(Array&& value) :
+    type(TYPE_NULL),
+    heap(false) {
+    set(std::move(value));
+}
+
+Value::Value(Object&& value) :
+    type(TYPE_NULL),
+    heap(false) {
+    set(std::move(value));
+}
+
+Value::Value(IntegerArray&& value) :
+    type(TYPE_NULL),
+    heap(false) {
+    set(std::move(value));
+}
+
+Value::Value(FloatArray&& value) :
+    type(TYPE_NULL),
+    heap(false) {
+    set(std::move(value));
+}
+
+Value::Value(const Value& value) :
+    type(TYPE_NULL),
+    heap(false) {
+    copy(value);
+}
+
+Value::Value(Value&& value) :
+    type(TYPE_NULL),
+    heap(false) {
+    // a copy of a linked value doesn't keep the link, neither does a moved one
+    if (value.isLinked()) {
+        copy(value);
+    } else {
+        take(value);
+    }
+}
+
 Value::Value(Value* const & value) :
-    value(new ArbitraryValue()) {
+    type(TYPE_NULL),
+    heap(false) {
     set(value);
 }
 
 Value::~Value() {
-
+    release();
 }
 
 bool Value::isUndefined() const {
@@ -171,6 +444,51 @@ Value::Object Value::getObject(Object defaultValue) const {
     return value;
 }
 
+const Value::String& Value::getStringRef() const {
+    static const String empty;
+    if (getType() != TYPE_STRING) {
+        return empty;
+    }
+
+    return cast<String>();
+}
+
+const Value::Array& Value::getArrayRef() const {
+    static const Array empty;
+    if (getType() != TYPE_ARRAY) {
+        return empty;
+    }
+
+    return cast<Array>();
+}
+
+const Value::Object& Value::getObjectRef() const {
+    static const Object empty;
+    if (getType() != TYPE_OBJECT) {
+        return empty;
+    }
+
+    return cast<Object>();
+}
+
+const Value::IntegerArray& Value::getIntegerArrayRef() const {
+    static const IntegerArray empty;
+    if (getPackedType() != TYPE_INTEGER) {
+        return empty;
+    }
+
+    return cast<IntegerArray>();
+}
+
+const Value::FloatArray& Value::getFloatArrayRef() const {
+    static const FloatArray empty;
+    if (getPackedType() != TYPE_FLOAT) {
+        return empty;
+    }
+
+    return cast<FloatArray>();
+}
+
 bool Value::get(Boolean& value, Boolean defaultValue) const {
     bool ok = get<Boolean>(value);
     if (!ok) {
@@ -201,7 +519,7 @@ bool Value::get(Float& value, Float defaultValue) const {
 bool Value::get(String& value, String defaultValue) const {
     bool ok = get<String>(value);
     if (!ok) {
-        value = defaultValue;
+        value = std::move(defaultValue);
     }
 
     return ok;
@@ -210,7 +528,7 @@ bool Value::get(String& value, String defaultValue) const {
 bool Value::get(Array& value, Array defaultValue) const {
     bool ok = get<Array>(value);
     if (!ok) {
-        value = defaultValue;
+        value = std::move(defaultValue);
     }
 
     return ok;
@@ -219,7 +537,7 @@ bool Value::get(Array& value, Array defaultValue) const {
 bool Value::get(Object& value, Object defaultValue) const {
     bool ok = get<Object>(value);
     if (!ok) {
-        value = defaultValue;
+        value = std::move(defaultValue);
     }
 
     return ok;
@@ -246,11 +564,11 @@ void Value::set(const Float64& value) {
 }
 
 void Value::set(const StringChar& value) {
-    set<String>(String(value)); // TODO
+    emplace<String>(String(value)); // TODO
 }
 
 void Value::set(const StringStd& value) {
-    set<String>(String(value.c_str())); // TODO
+    emplace<String>(String(value.c_str())); // TODO
 }
 
 void Value::set(const String& value) {
@@ -265,111 +583,256 @@ void Value::set(const Object& value) {
     set<Object>(value);
 }
 
+void Value::set(const IntegerArray& value) {
+    set<IntegerArray>(value);
+}
+
+void Value::set(const FloatArray& value) {
+    set<FloatArray>(value);
+}
+
+void Value::set(String&& value) {
+    emplace<String>(std::move(value));
+}
+
+void Value::set(Array&& value) {
+    emplace<Array>(std::move(value));
+}
+
+void Value::set(Object&& value) {
+    emplace<Object>(std::move(value));
+}
+
+void Value::set(IntegerArray&& value) {
+    emplace<IntegerArray>(std::move(value));
+}
+
+void Value::set(FloatArray&& value) {
+    emplace<FloatArray>(std::move(value));
+}
+
 void Value::set(const Value& value) {
-    if (value.isValid()) {
-        this->value->set(*value.value.get());
+    if (!value.isValid() || &value == this) {
+        return;
+    }
+
+    // linked values share one ArbitraryValue, write through to keep the link
+    if (isLinked()) {
+        data.p->set(value);
+
+        return;
+    }
+
+    // copy first, value might be a child of this value
+    Value v(value);
+    take(v);
+}
+
+void Value::set(Value&& value) {
+    if (!value.isValid() || &value == this) {
+        return;
+    }
+
+    // links are written through or resolved the same way as for a copy
+    if (isLinked() || value.isLinked()) {
+        set(static_cast<const Value&>(value));
+
+        return;
     }
+
+    take(value);
 }
 
 void Value::set(Value* const& value) {
-    if (value->isValid()) {
-        this->value = value->value; // TODO ok?
+    if (!value->isValid() || value == this) {
+        return;
+    }
+
+    // move an inline value to the heap, so that both values can share it
+    if (!value->heap) {
+        ArbitraryValue* p = new ArbitraryValue();
+        p->set(*value);
+        value->attach(p);
+    } else {
+        value->detach();
     }
+
+    ArbitraryValue* p = value->data.p;
+    p->linked = true;
+    p->ref.ref();
+    release();
+    data.p = p;
+    heap = true;
 }
 
 Value& Value::getValue(const QString& path) {
-    QStringList splitPath = path.trimmed().split(QRegExp("(\\.|\\[)"), QString::SkipEmptyParts);
+    return getValue(ValuePath(path));
+}
+
+const Value& Value::getValue(const QString& path) const {
+    return getValue(ValuePath(path));
+}
 
+Value& Value::getValue(const ValuePath& path) {
     Value* value = this;
-    for (int i = 0; i < splitPath.size(); i++) {
-        QString name = splitPath[i];
-        if (name.at(name.length() - 1) == ']') {
-            int index = name.remove(name.length() - 1, 1).toInt();
-            value = &(*value)[index];
+    for (int i = 0; i < path.size(); i++) {
+        const ValuePath::Segment& segment = path[i];
+        if (segment.index >= 0) {
+            value = &(*value)[segment.index];
         } else {
-            value = &(*value)[name];
+            value = &(*value)[segment.key];
         }
     }
 
     return *value;
 }
 
-const Value& Value::getValue(const QString& path) const {
-    QStringList splitPath = path.trimmed().split(QRegExp("(\\.|\\[)"), QString::SkipEmptyParts);
-
+const Value& Value::getValue(const ValuePath& path) const {
     const Value* value = this;
-    for (int i = 0; i < splitPath.size(); i++) {
-        QString name = splitPath[i];
-        if (name.at(name.length() - 1) == ']') {
-            int index = name.remove(name.length() - 1, 1).toInt();
-            value = &(*value)[index];
+    for (int i = 0; i < path.size(); i++) {
+        const ValuePath::Segment& segment = path[i];
+        if (segment.index >= 0) {
+            value = &(*value)[segment.index];
         } else {
-            value = &(*value)[name];
+            value = &(*value)[segment.key];
         }
     }
 
     return *value;
 }
 
-void Value::unite(const Value& value) {
+bool Value::unite(const Value& value, QList<ValuePath>* changes) {
+    if (!uniteChanges(*this, value)) {
+        return false;
+    }
+
+    ValuePath path;
+
+    return unite(value, path, changes);
+}
+
+bool Value::unite(const Value& value, ValuePath& path, QList<ValuePath>* changes) {
+    // only the children which change are accessed for writing, everything else stays shared with copies of this value
     if (isArray() && value.isArray()) {
-        ArrayIterator a1 = *this;
-        ArrayIterator a2 = value;
-        for (; a2; a2++) {
-            a1[a2.index()].unite(*a2);
+        Type packed = getPackedType();
+        if (packed == TYPE_INTEGER && value.getPackedType() == TYPE_INTEGER) {
+            IntegerArray array = getIntegerArrayRef();
+            uniteVector(array, value.getIntegerArrayRef(), path, changes);
+            set(std::move(array));
+        } else if (packed == TYPE_FLOAT && value.getPackedType() == TYPE_FLOAT) {
+            FloatArray array = getFloatArrayRef();
+            uniteVector(array, value.getFloatArrayRef(), path, changes);
+            set(std::move(array));
+        } else {
+            for (int i = 0; i < value.size(); i++) {
+                ValuePath::Segment segment;
+                segment.index = i;
+                path.segments.append(segment);
+
+                Value element = value.at(i);
+                if (i >= size()) {
+                    (*this)[i] = element;
+                    if (changes != NULL) {
+                        changes->append(ValuePath(path.segments));
+                    }
+                } else if (uniteChanges(at(i), element)) {
+                    (*this)[i].unite(element, path, changes);
+                }
+
+                path.segments.removeLast();
+            }
         }
     } else if (isObject() && value.isObject()) {
-        ObjectIterator o1 = *this;
-        ObjectIterator o2 = value;
-        for (; o2; o2++) {
-            o1[o2.key()].unite(*o2);
+        const Object& object = value.cast<Object>();
+        for (Object::const_iterator it = object.begin(); it != object.end(); it++) {
+            ValuePath::Segment segment;
+            segment.key = it.atom();
+            segment.index = -1;
+            path.segments.append(segment);
+
+            const Value& current = static_cast<const Value&>(*this)[it.atom()];
+            if (!current.isValid()) {
+                (*this)[it.atom()] = it.value();
+                if (changes != NULL) {
+                    changes->append(ValuePath(path.segments));
+                }
+            } else if (uniteChanges(current, it.value())) {
+                (*this)[it.atom()].unite(it.value(), path, changes);
+            }
+
+            path.segments.removeLast();
         }
     } else {
         *this = value;
+        if (changes != NULL) {
+            changes->append(ValuePath(path.segments));
+        }
     }
+
+    return true;
 }
 
-int Value::size() {
-    if (value->getType() == TYPE_ARRAY) {
-        Array& array = value->get<Array>();
+void Value::promote() {
+    if (!heap) {
+        return;
+    }
+
+    // copies have to go to the heap, even if an arena is active
+    ValueArena::Scope scope(NULL);
+
+    // a linked ArbitraryValue is shared with the value it links to and can't be replaced
+    if (!data.p->linked && ArbitraryValue::arenaOf(data.p) != NULL) {
+        attach(new ArbitraryValue(*data.p));
+    }
+    data.p->promote();
+}
 
-        return array.size();
+int Value::size() const {
+    if (getType() == TYPE_ARRAY) {
+        return data.p->size();
     }
 
     return -1;
 }
 
-void Value::remove(const QString& key) {
-    if (value->getType() == TYPE_OBJECT) {
-        Object& object = value->get<Object>();
+Value Value::at(int i) const {
+    if (getType() != TYPE_ARRAY) {
+        return Value();
+    }
+
+    return data.p->at(i);
+}
+
+void Value::remove(const ValueKey& key) {
+    if (getType() == TYPE_OBJECT) {
+        Object& object = cast<Object>();
         object.remove(key);
     }
 }
 
 void Value::remove(int i) {
-    if (value->getType() == TYPE_ARRAY) {
-        Array& array = value->get<Array>();
+    if (getType() == TYPE_ARRAY) {
+        Array& array = cast<Array>();
         array.removeAt(i);
     }
 }
 
-bool Value::contains(const QString& key) {
-    if (value->getType() == TYPE_OBJECT) {
-        Object& object = value->get<Object>();
-        Object::iterator it = object.find(key.toStdString().c_str());
+bool Value::contains(const ValueKey& key) const {
+    if (getType() == TYPE_OBJECT) {
+        const Object& object = cast<Object>();
 
-        return it != object.end();
+        return object.contains(key);
     }
 
     return false;
 }
 
 void Value::undefined() {
-    value->set<Undefined>(Undefined());
+    set<Undefined>(Undefined());
 }
 
 void Value::null() {
-    value->set<Null>(Null());
+    set<Null>(Null());
 }
 
 bool Value::isValid() const {
@@ -377,35 +840,56 @@ bool Value::isValid() const {
 }
 
 const Value::Type& Value::getType() const {
-    return value->getType();
+    if (heap) {
+        return data.p->getType();
+    }
+
+    return type;
+}
+
+Value::Type Value::getPackedType() const {
+    if (heap) {
+        switch (data.p->getPacking()) {
+        case ArbitraryValue::PACKED_INTEGER:
+            return TYPE_INTEGER;
+        case ArbitraryValue::PACKED_FLOAT:
+            return TYPE_FLOAT;
+        default:
+            break;
+        }
+    }
+
+    return TYPE_UNDEFINED;
 }
 
-Value::String Value::toString() {
-    if (value->getType() == TYPE_UNDEFINED) {
+Value::String Value::toString() const {
+    if (getType() == TYPE_UNDEFINED) {
         return "undefined";
-    } else if (value->getType() == TYPE_NULL) {
+    } else if (getType() == TYPE_NULL) {
         return "null";
-    } else if (value->getType() == TYPE_BOOLEAN) {
-        Boolean& v = value->get<Boolean>();
+    } else if (getType() == TYPE_BOOLEAN) {
+        const Boolean& v = cast<Boolean>();
 
         return (v) ? "true" : "false";
-    } else if (value->getType() == TYPE_INTEGER) {
-        Integer& v = value->get<Integer>();
+    } else if (getType() == TYPE_INTEGER) {
+        const Integer& v = cast<Integer>();
 
         return QString::number(v);
-    } else if (value->getType() == TYPE_FLOAT) {
-        Float& v = value->get<Float>();
+    } else if (getType() == TYPE_FLOAT) {
+        const Float& v = cast<Float>();
 
         return QString::number(v);
-    } else if (value->getType() == TYPE_STRING) {
-        String& v = value->get<String>();
+    } else if (getType() == TYPE_STRING) {
+        const String& v = cast<String>();
 
         return String(v);
-    } else if (value->getType() == TYPE_ARRAY) {
+    } else if (getType() == TYPE_ARRAY) {
         return "[Array]";
-    } else if (value->getType() == TYPE_OBJECT) {
+    } else if (getType() == TYPE_OBJECT) {
         return "[Object]";
     }
+
+    return String();
 }
 
 bool Value::toXml(QString& xml, bool pretty) const {
@@ -437,24 +921,43 @@ bool Value::toXml(QString& xml, bool pretty) const {
     return true;
 }
 
-bool Value::toJson(QString& json, bool pretty) const {
-    Json::Value root;
-    if (!buildToJson(this, &root)) {
-        logger->warning("couldn't build json from value container");
+bool Value::toXml(pugi::xml_node& xml) const {
+    pugi::xml_attribute typeAttribute = xml.attribute("type");
+    if (typeAttribute.empty()) {
+        typeAttribute = xml.append_attribute("type");
+    }
+    typeAttribute.set_value(typeNames[getType()]);
+
+    if (!buildToXml(this, &xml)) {
+        logger->warning("couldn't build xml from value container");
 
         return false;
     }
 
-    Json::Writer* writer;
-    if (pretty) {
-        writer = new Json::StyledWriter();
-    } else {
-        writer = new Json::FastWriter();
+    return true;
+}
+
+bool Value::toJson(QString& json, bool pretty) const {
+    QByteArray utf8;
+    if (!toJson(utf8, pretty)) {
+        return false;
     }
 
-    json = writer->write(root).c_str();
+    json = QString::fromUtf8(utf8.constData(), utf8.size());
+
+    return true;
+}
+
+bool Value::toJson(QByteArray& json, bool pretty) const {
+    ValueJsonWriter writer(json, pretty);
+    writer.write(*this);
+
+    return true;
+}
 
-    delete writer;
+bool Value::toBinary(QByteArray& binary) const {
+    ValueCborWriter writer(binary);
+    writer.write(*this);
 
     return true;
 }
@@ -475,16 +978,26 @@ bool Value::toYaml(QString& yaml) const {
 }
 
 bool Value::fromXml(const QString& xml) {
+    QByteArray utf8 = xml.toUtf8();
     pugi::xml_document doc;
-    pugi::xml_parse_result result = doc.load_buffer(xml.toStdString().c_str(), xml.size());
+    pugi::xml_parse_result result = doc.load_buffer(utf8.constData(), utf8.size());
     if (result.status != pugi::status_ok) {
         logger->warning(QString("couldn't set value container from xml: %1").arg(result.description()));
 
         return false;
     }
 
-    pugi::xml_node root = doc.root().first_child();
-    if (!buildFromXml(this, &root)) {
+    return fromXml(doc.root().first_child());
+}
+
+bool Value::fromXml(const pugi::xml_node& xml) {
+    if (xml.empty()) {
+        logger->warning("couldn't set value container from xml: empty node");
+
+        return false;
+    }
+
+    if (!buildFromXml(this, xml)) {
         logger->warning("couldn't set value container from xml");
 
         return false;
@@ -494,16 +1007,15 @@ bool Value::fromXml(const QString& xml) {
 }
 
 bool Value::fromJson(const QString& json) {
-    Json::Value root;
-    Json::Reader reader;
-    if (!reader.parse(json.toStdString(), root)) {
-        logger->warning(QString("couldn't set value container from json: %1").arg(reader.getFormatedErrorMessages().c_str()));
+    QByteArray utf8 = json.toUtf8();
 
-        return false;
-    }
+    return fromJson(utf8.constData(), utf8.size());
+}
 
-    if (!buildFromJson(this, &root)) {
-        logger->warning("couldn't set value container from json");
+bool Value::fromJson(const char* json, int size) {
+    ValueJsonReader reader(json, size);
+    if (!reader.read(*this)) {
+        logger->warning(QString("couldn't set value container from json: %1").arg(reader.getError()));
 
         return false;
     }
@@ -511,11 +1023,35 @@ bool Value::fromJson(const QString& json) {
     return true;
 }
 
-bool Value::fromYaml(const QString& yaml) {
-    try {
-        YAML::Node root = YAML::Load(yaml.toStdString());
+bool Value::fromBinary(const QByteArray& binary) {
+    return fromBinary(binary.constData(), binary.size());
+}
 
-        if (!buildFromYaml(this, &root)) {
+bool Value::fromBinary(const char* binary, int size) {
+    ValueCborReader reader(binary, size);
+    Value value;
+    if (!reader.read(value)) {
+        logger->warning(QString("couldn't set value container from binary: %1").arg(reader.getError()));
+
+        return false;
+    }
+
+    if (reader.getPosition() != size) {
+        logger->warning("couldn't set value container from binary: unexpected data after value");
+
+        return false;
+    }
+
+    *this = std::move(value);
+
+    return true;
+}
+
+bool Value::fromYaml(const QString& yaml) {
+    try {
+        YAML::Node root = YAML::Load(yaml.toStdString());
+
+        if (!buildFromYaml(this, &root)) {
             logger->warning("couldn't set value container from yaml");
 
             return false;
@@ -589,56 +1125,111 @@ const Value& Value::operator=(const Object& value) {
     return *this;
 }
 
+const Value& Value::operator=(const IntegerArray& value) {
+    set(value);
+
+    return *this;
+}
+
+const Value& Value::operator=(const FloatArray& value) {
+    set(value);
+
+    return *this;
+}
+
+const Value& Value::operator=(String&& value) {
+    set(std::move(value));
+
+    return *this;
+}
+
+const Value& Value::operator=(Array&& value) {
+    set(std::move(value));
+
+    return *this;
+}
+
+const Value& Value::operator=(Object&& value) {
+    set(std::move(value));
+
+    return *this;
+}
+
+const Value& Value::operator=(IntegerArray&& value) {
+    set(std::move(value));
+
+    return *this;
+}
+
+const Value& Value::operator=(FloatArray&& value) {
+    set(std::move(value));
+
+    return *this;
+}
+
 const Value& Value::operator=(const Value& other) {
-    if (other.isValid()) {
-        this->value->set(*other.value); // TODO
-    }
+    set(other);
+
+    return *this;
+}
+
+const Value& Value::operator=(Value&& other) {
+    set(std::move(other));
 
     return *this;
 }
 
 const Value& Value::operator=(const Value* other) {
-    if (other->isValid()) {
-        value = other->value; // TODO
-    }
+    set(const_cast<Value*>(other));
 
     return *this;
 }
 
 bool Value::operator==(const Value& other) const {
-    return *value == *other.value;
+    const Type& t = getType();
+    if (t != other.getType()) {
+        return false;
+    }
+
+    switch (t) {
+    case TYPE_BOOLEAN:
+        return cast<Boolean>() == other.cast<Boolean>();
+    case TYPE_INTEGER:
+        return cast<Integer>() == other.cast<Integer>();
+    case TYPE_FLOAT:
+        return cast<Float>() == other.cast<Float>();
+    case TYPE_STRING:
+        return cast<String>() == other.cast<String>();
+    case TYPE_ARRAY:
+        return *data.p == *other.data.p;
+    case TYPE_OBJECT:
+        return cast<Object>() == other.cast<Object>();
+    default:
+        return false;
+    }
 }
 
 bool Value::operator!=(const Value& other) const {
-    return !(*value == *other.value);
+    return !(*this == other);
 }
 
-Value& Value::operator[](const QString& name) {
+Value& Value::operator[](const ValueKey& name) {
     if (getType() != TYPE_OBJECT) {
-        value->set(Object());
+        set(Object());
     }
 
-    Object& object = value->get<Object>();
-    Object::iterator it = object.find(name);
-    // value does not exist
-    if (it == object.end()) {
-        Value& value = object.insert(name, Value()).value();
-        value.null();
+    // inserts a null value if the value does not exist
+    Object& object = cast<Object>();
 
-        return value;
-    }
-    // value exist
-    else {
-        return it.value();
-    }
+    return object[name];
 }
 
-const Value& Value::operator[](const QString& name) const {
+const Value& Value::operator[](const ValueKey& name) const {
     if (getType() != TYPE_OBJECT) {
         return NullValue::ref();
     }
 
-    const Object& object = value->get<Object>();
+    const Object& object = cast<Object>();
     Object::const_iterator it = object.find(name);
     // value does not exist
     if (it == object.end()) {
@@ -655,7 +1246,7 @@ Value& Value::operator[](int i) {
         set(Array());
     }
 
-    Array& array = value->get<Array>();
+    Array& array = cast<Array>();
     for (int j = array.size() - i - 1; j < 0; j++) {
         array.append(Value());
     }
@@ -668,7 +1259,7 @@ const Value& Value::operator[](int i) const {
         return NullValue::ref();
     }
 
-    const Array& array = value->get<Array>();
+    const Array& array = cast<Array>();
     if (i >= array.size()) {
         return NullValue::ref();
     }
@@ -678,19 +1269,228 @@ const Value& Value::operator[](int i) const {
 
 template<typename T>
 bool Value::get(T& value) const {
-    try {
-        value = this->value->get<T>();
-
-        return true;
-    } catch (ArbitraryValueException e) {
+    if (getType() != ArbitraryValueTypeContainer<T>::type) {
+        return false;
     }
 
-    return false;
+    value = cast<T>();
+
+    return true;
 }
 
 template<typename T>
 void Value::set(const T& value) {
-    this->value->set<T>(value);
+    // linked values share one ArbitraryValue, write through to keep the link
+    if (isLinked()) {
+        data.p->set<T>(value);
+
+        return;
+    }
+
+    // scalars are stored inline, everything else in an ArbitraryValue owned by this value
+    if (ArbitraryValueTypeContainer<T>::inlined) {
+        release();
+        type = ArbitraryValueTypeContainer<T>::type;
+        memcpy(&data, &value, sizeof(T));
+    } else {
+        // don't overwrite an ArbitraryValue which is shared with copies of this value
+        if (!heap || data.p->ref.load() > 1) {
+            ArbitraryValue* p = new ArbitraryValue();
+            p->set<T>(value);
+            attach(p);
+        } else {
+            data.p->set<T>(value);
+        }
+    }
+}
+
+template<typename T>
+void Value::emplace(T&& value) {
+    if (isLinked()) {
+        data.p->set(std::move(value));
+
+        return;
+    }
+
+    // don't overwrite an ArbitraryValue which is shared with copies of this value
+    if (!heap || data.p->ref.load() > 1) {
+        ArbitraryValue* p = new ArbitraryValue();
+        p->set(std::move(value));
+        attach(p);
+    } else {
+        data.p->set(std::move(value));
+    }
+}
+
+template<typename T>
+T& Value::cast() {
+    if (heap) {
+        detach();
+
+        return data.p->get<T>();
+    }
+
+    return *reinterpret_cast<T*>(&data);
+}
+
+template<typename T>
+const T& Value::cast() const {
+    if (heap) {
+        return static_cast<const ArbitraryValue*>(data.p)->get<T>();
+    }
+
+    return *reinterpret_cast<const T*>(&data);
+}
+
+template<typename T>
+void Value::uniteVector(QVector<T>& target, const QVector<T>& source, ValuePath& path, QList<ValuePath>* changes) {
+    for (int i = 0; i < source.size(); i++) {
+        if (i < target.size() && target.at(i) == source.at(i)) {
+            continue;
+        }
+
+        if (i < target.size()) {
+            target[i] = source.at(i);
+        } else {
+            target.append(source.at(i));
+        }
+
+        if (changes != NULL) {
+            ValuePath::Segment segment;
+            segment.index = i;
+            path.segments.append(segment);
+            changes->append(ValuePath(path.segments));
+            path.segments.removeLast();
+        }
+    }
+}
+
+bool Value::uniteChanges(const Value& target, const Value& value) {
+    // the same ArbitraryValue, e.g. a copy of the target which hasn't been modified
+    if (target.heap && value.heap && target.data.p == value.data.p) {
+        return false;
+    }
+
+    if (target.isArray() && value.isArray()) {
+        if (value.size() > target.size()) {
+            return true;
+        }
+
+        // elements of packed arrays are compared without unpacking them
+        bool packed = target.getPackedType() != TYPE_UNDEFINED || value.getPackedType() != TYPE_UNDEFINED;
+        for (int i = 0; i < value.size(); i++) {
+            if (packed ? target.at(i) != value.at(i) : uniteChanges(target.cast<Array>().at(i), value.cast<Array>().at(i))) {
+                return true;
+            }
+        }
+
+        return false;
+    } else if (target.isObject() && value.isObject()) {
+        const Object& current = target.cast<Object>();
+        const Object& object = value.cast<Object>();
+        for (Object::const_iterator it = object.begin(); it != object.end(); it++) {
+            Object::const_iterator c = current.find(it.atom());
+            if (c == current.end() || uniteChanges(c.value(), it.value())) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    return target != value;
+}
+
+bool Value::isLinked() const {
+    return heap && data.p->linked;
+}
+
+void Value::attach(ArbitraryValue* value) {
+    value->ref.ref();
+    release();
+    data.p = value;
+    heap = true;
+}
+
+void Value::detach() {
+    // copy on write: linked values are written through, copies get their own ArbitraryValue
+    if (heap && !data.p->linked && data.p->ref.load() > 1) {
+        attach(new ArbitraryValue(*data.p));
+    }
+}
+
+void Value::release() {
+    if (heap) {
+        if (!data.p->ref.deref()) {
+            delete data.p;
+        }
+
+        heap = false;
+    }
+
+    type = TYPE_NULL;
+    data.p = NULL;
+}
+
+void Value::take(Value& other) {
+    // reset other first, it might be a child of this value
+    Type t = other.type;
+    bool h = other.heap;
+    Data d = other.data;
+    other.type = TYPE_NULL;
+    other.heap = false;
+    other.data.p = NULL;
+
+    release();
+    type = t;
+    heap = h;
+    data = d;
+}
+
+void Value::copy(const Value& other) {
+    if (!other.isValid()) {
+        return;
+    }
+
+    const Type& t = other.getType();
+    if (other.heap && !other.data.p->linked) {
+        attach(other.data.p);
+    } else if (t == TYPE_STRING || t == TYPE_ARRAY || t == TYPE_OBJECT) {
+        attach(new ArbitraryValue(*other.data.p));
+    } else if (other.heap) {
+        release();
+        type = t;
+        memcpy(&data, other.data.p->ptr(), sizeof(data));
+    } else {
+        release();
+        type = other.type;
+        data = other.data;
+    }
+}
+
+void Value::share(const Value& other) {
+    if (other.heap) {
+        attach(other.data.p);
+    } else {
+        release();
+        type = other.type;
+        data = other.data;
+    }
+}
+
+// objects are ordered by key atom, write their values ordered by key name
+static QVector<Value::Object::const_iterator> sortByKey(const Value::Object& object) {
+    QVector<Value::Object::const_iterator> sorted;
+    sorted.reserve(object.size());
+    for (Value::Object::const_iterator it = object.begin(); it != object.end(); it++) {
+        sorted.append(it);
+    }
+
+    std::sort(sorted.begin(), sorted.end(), [](const Value::Object::const_iterator& a, const Value::Object::const_iterator& b) {
+        return a.key() < b.key();
+    });
+
+    return sorted;
 }
 
 bool Value::buildToXml(const Value* value, pugi::xml_node* xmlValue) const {
@@ -701,31 +1501,33 @@ bool Value::buildToXml(const Value* value, pugi::xml_node* xmlValue) const {
     } else if (value->isInteger()) {
         Integer v;
         value->get(v);
-        xmlValue->text().set(QString::number(v).toStdString().c_str());
+        xmlValue->text().set(QByteArray::number(static_cast<qlonglong>(v)).constData());
     } else if (value->isFloat()) {
         Float v;
         value->get(v);
-        xmlValue->text().set(QString::number(v).toStdString().c_str());
+        xmlValue->text().set(QByteArray::number(v).constData());
     } else if (value->isString()) {
-        String v;
-        value->get(v);
-        xmlValue->text().set(v.toStdString().c_str());
+        xmlValue->text().set(value->getStringRef().toUtf8().constData());
     } else if (value->isArray()) {
-        for (ArrayIterator it = *value; it; it++) {
+        // packed arrays are exported element by element without unpacking them
+        for (int i = 0; i < value->size(); i++) {
+            Value v = value->at(i);
             pugi::xml_node dataChild = xmlValue->append_child("value");
             pugi::xml_attribute typeAttribute = dataChild.append_attribute("type");
-            typeAttribute.set_value(typeNames[it->getType()]);
-            if (!buildToXml(&*it, &dataChild)) {
+            typeAttribute.set_value(typeNames[v.getType()]);
+            if (!buildToXml(&v, &dataChild)) {
                 return false;
             }
         }
     } else if (value->isObject()) {
-        for (ObjectIterator it = *value; it; it++) {
+        QVector<Object::const_iterator> v = sortByKey(value->cast<Object>());
+        for (int i = 0; i < v.size(); i++) {
+            const Object::const_iterator& it = v[i];
             pugi::xml_node dataChild = xmlValue->append_child("value");
             pugi::xml_attribute nameAttribute = dataChild.append_attribute("name");
             pugi::xml_attribute typeAttribute = dataChild.append_attribute("type");
             nameAttribute.set_value(it.key().toStdString().c_str());
-            typeAttribute.set_value(typeNames[it->getType()]);
+            typeAttribute.set_value(typeNames[it.value().getType()]);
             if (!buildToXml(&it.value(), &dataChild)) {
                 return false;
             }
@@ -735,50 +1537,6 @@ bool Value::buildToXml(const Value* value, pugi::xml_node* xmlValue) const {
     return true;
 }
 
-bool Value::buildToJson(const Value* value, Json::Value* jsonValue) const {
-    if (value->isBoolean()) {
-        Boolean v;
-        value->get(v);
-        *jsonValue = v;
-    } else if (value->isInteger()) {
-        Integer v;
-        value->get(v);
-        *jsonValue = (int)v; // TODO
-    } else if (value->isFloat()) {
-        Float v;
-        value->get(v);
-        *jsonValue = v;
-    } else if (value->isString()) {
-        String v;
-        value->get(v);
-        *jsonValue = v.toStdString();
-    } else if (value->isArray()) {
-        Array v;
-        value->get(v);
-        *jsonValue = Json::Value(Json::arrayValue);
-        for (int i = 0; i < v.size(); i++) {
-            Json::Value dataChild;
-            if (!buildToJson(&v[i], &dataChild)) {
-                return false;
-            }
-            (*jsonValue)[i] = dataChild;
-        }
-    } else if (value->isObject()) {
-        Object v;
-        value->get(v);
-        *jsonValue = Json::Value(Json::objectValue);
-        for (Object::const_iterator it = v.begin(); it != v.end(); it++) {
-            Json::Value dataChild;
-            if (!buildToJson(&it.value(), &dataChild)) {
-                return false;
-            }
-            (*jsonValue)[it.key().toStdString()] = dataChild;
-        }
-    }
-
-    return true;
-}
-
 bool Value::buildToYaml(const Value* value, YAML::Node* yamlValue) const {
     if (value->isBoolean()) {
         Boolean v;
@@ -797,19 +1555,18 @@ bool Value::buildToYaml(const Value* value, YAML::Node* yamlValue) const {
         value->get(v);
         *yamlValue = v.toStdString();
     } else if (value->isArray()) {
-        Array v;
-        value->get(v);
-        for (int i = 0; i < v.size(); i++) {
+        for (int i = 0; i < value->size(); i++) {
+            Value v = value->at(i);
             YAML::Node dataChild;
-            if (!buildToYaml(&v[i], &dataChild)) {
+            if (!buildToYaml(&v, &dataChild)) {
                 return false;
             }
             yamlValue->push_back(dataChild);
         }
     } else if (value->isObject()) {
-        Object v;
-        value->get(v);
-        for (Object::const_iterator it = v.begin(); it != v.end(); it++) {
+        QVector<Object::const_iterator> v = sortByKey(value->cast<Object>());
+        for (int i = 0; i < v.size(); i++) {
+            const Object::const_iterator& it = v[i];
             YAML::Node dataChild;
             if (!buildToYaml(&it.value(), &dataChild)) {
                 return false;
@@ -821,84 +1578,43 @@ bool Value::buildToYaml(const Value* value, YAML::Node* yamlValue) const {
     return true;
 }
 
-bool Value::buildFromXml(Value* value, pugi::xml_node* xmlValue) {
-    pugi::xml_attribute typeAttribute = xmlValue->attribute("type");
-    pugi::xml_text textContent = xmlValue->text();
-
-    QString type = typeAttribute.value();
-
-    if (type == "Boolean") {
-        value->set(textContent.as_bool());
-    } else if (type == "Integer") {
-        value->set(QString(textContent.get()).toInt());
-    } else if (type == "Float") {
-        value->set(QString(textContent.get()).toDouble());
-    } else if (type == "String") {
-        value->set(textContent.as_string());
-    } else if (type == "Array") {
+bool Value::buildFromXml(Value* value, const pugi::xml_node& xmlValue) {
+    // the node is read in place, the text is converted without going through an intermediate QString
+    const char* type = xmlValue.attribute("type").value();
+    const char* text = xmlValue.text().get();
+
+    if (strcmp(type, "Boolean") == 0) {
+        value->set(xmlValue.text().as_bool());
+    } else if (strcmp(type, "Integer") == 0) {
+        value->set(static_cast<Integer>(QByteArray::fromRawData(text, static_cast<int>(strlen(text))).trimmed().toLongLong()));
+    } else if (strcmp(type, "Float") == 0) {
+        value->set(QByteArray::fromRawData(text, static_cast<int>(strlen(text))).trimmed().toDouble());
+    } else if (strcmp(type, "String") == 0) {
+        value->set(QString::fromUtf8(text));
+    } else if (strcmp(type, "Array") == 0) {
         Array array;
-        for (pugi::xml_node_iterator i = xmlValue->begin(); i != xmlValue->end(); i++) {
+        for (pugi::xml_node child = xmlValue.first_child(); child; child = child.next_sibling()) {
             Value v;
-            if (!buildFromXml(&v, (pugi::xml_node*)&i)) {
+            if (!buildFromXml(&v, child)) {
                 return false;
             }
-            array.append(v);
+            array.append(std::move(v));
         }
-        value->set(array);
+        value->set(std::move(array));
     } else {
         Object object;
-        for (pugi::xml_node_iterator i = xmlValue->begin(); i != xmlValue->end(); i++) {
+        for (pugi::xml_node child = xmlValue.first_child(); child; child = child.next_sibling()) {
             Value v;
-            if (!buildFromXml(&v, (pugi::xml_node*)&i)) {
+            if (!buildFromXml(&v, child)) {
                 return false;
             }
 
-            pugi::xml_attribute nameAttribute = i->attribute("name");
-            QString key = i->name();
-
-            if (!nameAttribute.empty()) {
-                key = nameAttribute.value();
-            }
-
-            object.insert(key, v);
-        }
-        value->set(object);
-    }
-
-    return true;
-}
+            pugi::xml_attribute nameAttribute = child.attribute("name");
+            const char* key = nameAttribute.empty() ? child.name() : nameAttribute.value();
 
-bool Value::buildFromJson(Value* value, Json::Value* jsonValue) {
-    if (jsonValue->isNull()) {
-        value->null();
-    } else if (jsonValue->isBool()) {
-        value->set(jsonValue->asBool());
-    } else if (jsonValue->isInt()) {
-        value->set(jsonValue->asInt());
-    } else if (jsonValue->isDouble()) {
-        value->set(jsonValue->asDouble());
-    } else if (jsonValue->isString()) {
-        value->set(jsonValue->asString().c_str());
-    } else if (jsonValue->isArray()) {
-        Array array;
-        for (unsigned int i = 0; i < jsonValue->size(); i++) {
-            Value v;
-            if (!buildFromJson(&v, &(*jsonValue)[i])) {
-                return false;
-            }
-            array.append(v);
+            object[ValueKey(key)] = std::move(v);
         }
-        value->set(array);
-    } else if (jsonValue->isObject()) {
-        Object object;
-        for (Json::ValueIterator i = jsonValue->begin(); i != jsonValue->end(); i++) {
-            Value v;
-            if (!buildFromJson(&v, &*i)) {
-                return false;
-            }
-            object.insert(i.memberName(), v);
-        }
-        value->set(object);
+        value->set(std::move(object));
     }
 
     return true;
@@ -951,10 +1667,10 @@ bool Value::buildFromYaml(Value* value, YAML::Node* yamlValue) {
 /*
  * ArrayIterator
  */
-Value::ArrayIterator::ArrayIterator(const Value& value) :
+Value::ArrayIterator::ArrayIterator(Value& value) :
     array(NULL) {
     if (value.isArray()) {
-        array = &value.value->get<Array>();
+        array = &value.cast<Array>();
         it = array->begin();
     }
 }
@@ -972,126 +1688,2823 @@ Value& Value::ArrayIterator::operator[](int i) {
 }
 
 /*
- * ObjectIterator
+ * ConstArrayIterator
  */
-Value::ObjectIterator::ObjectIterator(const Value& value) :
-    object(NULL) {
-    if (value.isObject()) {
-        object = &value.value->get<Object>();
-        it = object->begin();
+Value::ConstArrayIterator::ConstArrayIterator(const Value& value) :
+    array(NULL) {
+    // a shared value is iterated without detaching it
+    if (value.isArray()) {
+        array = &value.cast<Array>();
+        it = array->begin();
     }
 }
 
-Value& Value::ObjectIterator::operator[](const Value::String key) {
-    if (object == NULL) {
+const Value& Value::ConstArrayIterator::operator[](int i) const {
+    if (array == NULL || i < 0 || i >= array->size()) {
         return NullValue::ref();
     }
 
-    return (*object)[key];
+    return array->at(i);
 }
 
 /*
- * NullValue
+ * Object
  */
-NullValue NullValue::instance;
-
-NullValue::NullValue() {
+Value::Object::iterator Value::Object::find(const ValueKey& key) {
+    int i = indexOf(key);
 
+    return iterator(this, (i < 0) ? keys.size() : i);
 }
 
-NullValue& NullValue::ref() {
-    return instance;
-}
+Value::Object::const_iterator Value::Object::find(const ValueKey& key) const {
+    int i = indexOf(key);
 
-const Value& NullValue::operator[](int i) const {
-    return *this;
+    return const_iterator(this, (i < 0) ? keys.size() : i);
 }
 
-const Value& NullValue::operator[](const QString& name) const {
-    return *this;
-}
+Value::Object::iterator Value::Object::insert(const ValueKey& key, const Value& value) {
+    int i = lowerBound(key);
+    if (i < keys.size() && keys.at(i) == key) {
+        values[i] = value;
+    } else {
+        keys.insert(i, key);
+        values.insert(i, value);
+    }
 
-template <typename T>
-bool NullValue::get(T& value) const {
-    return false;
+    return iterator(this, i);
 }
 
-/*
- * ArbitraryValueException
- */
-ArbitraryValueException::ArbitraryValueException() :
-    message("ArbitraryValueException") {
+int Value::Object::remove(const ValueKey& key) {
+    int i = indexOf(key);
+    if (i < 0) {
+        return 0;
+    }
 
+    keys.remove(i);
+    values.removeAt(i);
+
+    return 1;
 }
 
-ArbitraryValueException::ArbitraryValueException(const QString& message):
-    message(message) {
+void Value::Object::clear() {
+    keys.clear();
+    values.clear();
+}
+
+Value& Value::Object::operator[](const ValueKey& key) {
+    int i = lowerBound(key);
+    if (i == keys.size() || keys.at(i) != key) {
+        keys.insert(i, key);
+        values.insert(i, Value());
+    }
+
+    return values[i];
+}
+
+bool Value::Object::operator==(const Object& other) const {
+    return keys == other.keys && values == other.values;
+}
+
+bool Value::Object::operator!=(const Object& other) const {
+    return !(*this == other);
+}
+
+bool Value::Object::isDetached() const {
+    return keys.isDetached() && values.isDetached();
+}
+
+void Value::Object::detach() {
+    keys.detach();
+    values.detach();
+}
+
+int Value::Object::indexOf(const ValueKey& key) const {
+    int i = lowerBound(key);
+    if (i < keys.size() && keys.at(i) == key) {
+        return i;
+    }
+
+    return -1;
+}
+
+int Value::Object::lowerBound(const ValueKey& key) const {
+    const ValueKey* k = keys.constData();
+    int first = 0;
+    int count = keys.size();
+    while (count > 0) {
+        int step = count / 2;
+        if (k[first + step] < key) {
+            first += step + 1;
+            count -= step + 1;
+        } else {
+            count = step;
+        }
+    }
+
+    return first;
+}
+
+/*
+ * ObjectIterator
+ */
+Value::ObjectIterator::ObjectIterator(Value& value) :
+    object(NULL) {
+    if (value.isObject()) {
+        object = &value.cast<Object>();
+        it = object->begin();
+    }
+}
+
+Value& Value::ObjectIterator::operator[](const ValueKey& key) {
+    if (object == NULL) {
+        return NullValue::ref();
+    }
+
+    return (*object)[key];
+}
+
+/*
+ * ConstObjectIterator
+ */
+Value::ConstObjectIterator::ConstObjectIterator(const Value& value) :
+    object(NULL) {
+    // a shared value is iterated without detaching it
+    if (value.isObject()) {
+        object = &value.cast<Object>();
+        it = object->begin();
+    }
+}
+
+const Value& Value::ConstObjectIterator::operator[](const ValueKey& key) const {
+    if (object == NULL) {
+        return NullValue::ref();
+    }
+
+    Object::const_iterator found = object->find(key);
+    if (found == object->end()) {
+        return NullValue::ref();
+    }
+
+    return found.value();
+}
+
+/*
+ * NullValue
+ */
+NullValue NullValue::instance;
+
+NullValue::NullValue() {
+
+}
+
+NullValue& NullValue::ref() {
+    return instance;
+}
+
+const Value& NullValue::operator[](int i) const {
+    return *this;
+}
+
+const Value& NullValue::operator[](const ValueKey& name) const {
+    return *this;
+}
+
+template <typename T>
+bool NullValue::get(T& value) const {
+    return false;
+}
+
+/*
+ * ValuePath
+ */
+ValuePath::ValuePath() :
+    valid(true) {
+
+}
+
+ValuePath::ValuePath(const QString& path) :
+    path(path.trimmed()),
+    valid(true) {
+    // split at "." and "[", segments ending with "]" are array indices
+    const QChar* c = this->path.constData();
+    int length = this->path.length();
+    int start = 0;
+    for (int i = 0; i <= length; i++) {
+        if (i == length || c[i] == '.' || c[i] == '[') {
+            if (i > start) {
+                append(this->path.mid(start, i - start));
+            }
+            start = i + 1;
+        }
+    }
+}
+
+ValuePath::ValuePath(const QVector<Segment>& segments) :
+    segments(segments),
+    valid(true) {
+    for (int i = 0; i < segments.size(); i++) {
+        if (segments[i].index >= 0) {
+            path += QString("[%1]").arg(segments[i].index);
+        } else {
+            if (i > 0) {
+                path += '.';
+            }
+            path += segments[i].key.toString();
+        }
+    }
+}
+
+bool ValuePath::isValid() const {
+    return valid;
+}
+
+bool ValuePath::isEmpty() const {
+    return segments.isEmpty();
+}
+
+int ValuePath::size() const {
+    return segments.size();
+}
+
+const ValuePath::Segment& ValuePath::operator[](int i) const {
+    return segments[i];
+}
+
+const QString& ValuePath::toString() const {
+    return path;
+}
+
+void ValuePath::append(const QString& name) {
+    Segment segment;
+    if (name.endsWith(']')) {
+        bool ok;
+        segment.index = name.left(name.length() - 1).toInt(&ok);
+        if (!ok || segment.index < 0) {
+            segment.index = 0;
+            valid = false;
+        }
+    } else {
+        segment.key = name;
+        segment.index = -1;
+    }
+
+    segments.append(segment);
+}
+
+/*
+ * JSON scanning
+ */
+typedef struct {
+    // returns the first quote, backslash or control character, or end
+    const char* (*scanString)(const char* p, const char* end);
+    // returns the first quote, bracket or brace and counts the commas before it, or end
+    const char* (*scanArray)(const char* p, const char* end, int& commas);
+    // returns the first character that isn't a digit and accumulates the digits before it into the mantissa
+    const char* (*scanDigits)(const char* p, const char* end, unsigned long long& mantissa);
+} JsonScanner;
+
+static const char* scanStringScalar(const char* p, const char* end) {
+    while (p < end && *p != '"' && *p != '\\' && (unsigned char)*p >= 0x20) {
+        p++;
+    }
+
+    return p;
+}
+
+static const char* scanArrayScalar(const char* p, const char* end, int& commas) {
+    for (; p < end; p++) {
+        char c = *p;
+        if (c == ']' || c == '[' || c == '{' || c == '"') {
+            break;
+        } else if (c == ',') {
+            commas++;
+        }
+    }
+
+    return p;
+}
+
+static const char* scanDigitsScalar(const char* p, const char* end, unsigned long long& mantissa) {
+    while (p < end && *p >= '0' && *p <= '9') {
+        mantissa = mantissa * 10 + (*p - '0');
+        p++;
+    }
+
+    return p;
+}
+
+#ifdef VALUE_JSON_SIMD
+// converts eight ASCII digits at once, the bytes are combined pairwise into 2, 4 and 8 digit numbers
+static inline unsigned long long parseEightDigits(const char* p) {
+    unsigned long long v;
+    memcpy(&v, p, sizeof(v));
+    v = ((v & 0x0F0F0F0F0F0F0F0FULL) * 2561) >> 8;
+    v = ((v & 0x00FF00FF00FF00FFULL) * 6553601) >> 16;
+
+    return ((v & 0x0000FFFF0000FFFFULL) * 42949672960001ULL) >> 32;
+}
+
+__attribute__((target("sse2")))
+static const char* scanDigitsSse2(const char* p, const char* end, unsigned long long& mantissa) {
+    const __m128i zero = _mm_set1_epi8('0');
+    const __m128i nine = _mm_set1_epi8(9);
+    while (end - p >= 16) {
+        // unsigned c - '0' <= 9 if min(c - '0', 9) == c - '0'
+        __m128i chunk = _mm_sub_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)), zero);
+        unsigned int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(chunk, nine), chunk));
+        int run = __builtin_ctz(~mask);
+
+        // the mantissa wraps around like in the scalar loop, numbers with more than 19 digits aren't taken from it
+        const char* stop = p + run;
+        for (; stop - p >= 8; p += 8) {
+            mantissa = mantissa * 100000000 + parseEightDigits(p);
+        }
+        p = scanDigitsScalar(p, stop, mantissa);
+        if (run < 16) {
+            return p;
+        }
+    }
+
+    return scanDigitsScalar(p, end, mantissa);
+}
+
+__attribute__((target("sse2")))
+static const char* scanStringSse2(const char* p, const char* end) {
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i control = _mm_set1_epi8(0x1F);
+    while (end - p >= 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        __m128i match = _mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash));
+        // unsigned c <= 0x1F if min(c, 0x1F) == c
+        match = _mm_or_si128(match, _mm_cmpeq_epi8(_mm_min_epu8(chunk, control), chunk));
+        unsigned int mask = _mm_movemask_epi8(match);
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 16;
+    }
+
+    return scanStringScalar(p, end);
+}
+
+__attribute__((target("sse2")))
+static const char* scanArraySse2(const char* p, const char* end, int& commas) {
+    const __m128i comma = _mm_set1_epi8(',');
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i bracketOpen = _mm_set1_epi8('[');
+    const __m128i bracketClose = _mm_set1_epi8(']');
+    const __m128i brace = _mm_set1_epi8('{');
+    while (end - p >= 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        __m128i stop = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, brace)),
+                                    _mm_or_si128(_mm_cmpeq_epi8(chunk, bracketOpen), _mm_cmpeq_epi8(chunk, bracketClose)));
+        unsigned int stopMask = _mm_movemask_epi8(stop);
+        unsigned int commaMask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, comma));
+        if (stopMask != 0) {
+            int i = __builtin_ctz(stopMask);
+            commas += __builtin_popcount(commaMask & ((1u << i) - 1));
+
+            return p + i;
+        }
+        commas += __builtin_popcount(commaMask);
+        p += 16;
+    }
+
+    return scanArrayScalar(p, end, commas);
+}
+
+__attribute__((target("avx2")))
+static const char* scanStringAvx2(const char* p, const char* end) {
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    const __m256i control = _mm256_set1_epi8(0x1F);
+    while (end - p >= 32) {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        __m256i match = _mm256_or_si256(_mm256_cmpeq_epi8(chunk, quote), _mm256_cmpeq_epi8(chunk, backslash));
+        match = _mm256_or_si256(match, _mm256_cmpeq_epi8(_mm256_min_epu8(chunk, control), chunk));
+        unsigned int mask = _mm256_movemask_epi8(match);
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 32;
+    }
+
+    return scanStringSse2(p, end);
+}
+
+__attribute__((target("avx2")))
+static const char* scanArrayAvx2(const char* p, const char* end, int& commas) {
+    const __m256i comma = _mm256_set1_epi8(',');
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i bracketOpen = _mm256_set1_epi8('[');
+    const __m256i bracketClose = _mm256_set1_epi8(']');
+    const __m256i brace = _mm256_set1_epi8('{');
+    while (end - p >= 32) {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        __m256i stop = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(chunk, quote), _mm256_cmpeq_epi8(chunk, brace)),
+                                       _mm256_or_si256(_mm256_cmpeq_epi8(chunk, bracketOpen), _mm256_cmpeq_epi8(chunk, bracketClose)));
+        unsigned int stopMask = _mm256_movemask_epi8(stop);
+        unsigned int commaMask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, comma));
+        if (stopMask != 0) {
+            int i = __builtin_ctz(stopMask);
+            commas += __builtin_popcount(commaMask & ((1u << i) - 1));
+
+            return p + i;
+        }
+        commas += __builtin_popcount(commaMask);
+        p += 32;
+    }
+
+    return scanArraySse2(p, end, commas);
+}
+#endif
+
+static JsonScanner selectJsonScanner() {
+    JsonScanner scanner;
+    scanner.scanString = scanStringScalar;
+    scanner.scanArray = scanArrayScalar;
+    scanner.scanDigits = scanDigitsScalar;
+
+#ifdef VALUE_JSON_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        scanner.scanString = scanStringAvx2;
+        scanner.scanArray = scanArrayAvx2;
+        // numbers are shorter than 16 digits, a wider digit scan doesn't pay off
+        scanner.scanDigits = scanDigitsSse2;
+    } else if (__builtin_cpu_supports("sse2")) {
+        scanner.scanString = scanStringSse2;
+        scanner.scanArray = scanArraySse2;
+        scanner.scanDigits = scanDigitsSse2;
+    }
+#endif
+
+    return scanner;
+}
+
+static const JsonScanner jsonScanner = selectJsonScanner();
+
+/*
+ * ValueJsonReader
+ */
+static inline bool isDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+// every power of ten up to 1e22 is exactly representable as a double
+static const double powersOf10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+static void appendUtf8(std::string& buffer, uint code) {
+    if (code < 0x80) {
+        buffer += (char)code;
+    } else if (code < 0x800) {
+        buffer += (char)(0xC0 | (code >> 6));
+        buffer += (char)(0x80 | (code & 0x3F));
+    } else if (code < 0x10000) {
+        buffer += (char)(0xE0 | (code >> 12));
+        buffer += (char)(0x80 | ((code >> 6) & 0x3F));
+        buffer += (char)(0x80 | (code & 0x3F));
+    } else {
+        buffer += (char)(0xF0 | (code >> 18));
+        buffer += (char)(0x80 | ((code >> 12) & 0x3F));
+        buffer += (char)(0x80 | ((code >> 6) & 0x3F));
+        buffer += (char)(0x80 | (code & 0x3F));
+    }
+}
+
+ValueJsonReader::ValueJsonReader(const char* json, int size) :
+    begin(json),
+    pos(json),
+    end(json + size),
+    depth(0) {
+
+}
+
+bool ValueJsonReader::read(Value& value) {
+    pos = begin;
+    depth = 0;
+    error.clear();
+
+    // skip UTF-8 byte order mark
+    if (end - pos >= 3 && memcmp(pos, "\xEF\xBB\xBF", 3) == 0) {
+        pos += 3;
+    }
+
+    // the value is only replaced if the whole input is valid
+    Value result;
+    if (!readValue(result)) {
+        return false;
+    }
+
+    skipWhitespace();
+    if (pos != end) {
+        return fail("unexpected data after value");
+    }
+
+    value = std::move(result);
+
+    return true;
+}
+
+const QString& ValueJsonReader::getError() const {
+    return error;
+}
+
+bool ValueJsonReader::readValue(Value& value) {
+    skipWhitespace();
+    if (pos == end) {
+        return fail("unexpected end of data");
+    }
+
+    switch (*pos) {
+    case '{':
+        return readObject(value);
+    case '[':
+        return readArray(value);
+    case '"': {
+        QString string;
+        if (!readString(string)) {
+            return false;
+        }
+        value = std::move(string);
+
+        return true;
+    }
+    case 't':
+        if (!readLiteral("true", 4)) {
+            return false;
+        }
+        value = true;
+
+        return true;
+    case 'f':
+        if (!readLiteral("false", 5)) {
+            return false;
+        }
+        value = false;
+
+        return true;
+    case 'n':
+        if (!readLiteral("null", 4)) {
+            return false;
+        }
+        value.null();
+
+        return true;
+    default:
+        return readNumber(value);
+    }
+}
+
+bool ValueJsonReader::readLiteral(const char* literal, int size) {
+    if (end - pos < size || memcmp(pos, literal, size) != 0) {
+        return fail("invalid literal");
+    }
+    pos += size;
+
+    return true;
+}
+
+bool ValueJsonReader::readNumber(Value& value) {
+    Value::Integer integer;
+    Value::Float f;
+    bool integral;
+    if (!readNumber(integer, f, integral)) {
+        return false;
+    }
+
+    if (integral) {
+        value = integer;
+    } else {
+        value = f;
+    }
+
+    return true;
+}
+
+bool ValueJsonReader::readNumber(Value::Integer& integer, Value::Float& f, bool& integral) {
+    const char* start = pos;
+    bool negative = false;
+    if (*pos == '-') {
+        negative = true;
+        pos++;
+    }
+
+    if (pos == end || !isDigit(*pos)) {
+        return fail("invalid number");
+    }
+
+    if (*pos == '0' && pos + 1 < end && isDigit(pos[1])) {
+        return fail("invalid number, leading zero");
+    }
+
+    // all digits go into the mantissa, the position of the decimal point into the exponent
+    unsigned long long mantissa = 0;
+    const char* digitsStart = pos;
+    pos = jsonScanner.scanDigits(pos, end, mantissa);
+    int digits = pos - digitsStart;
+    int exponent = 0;
+
+    integral = true;
+    if (pos < end && *pos == '.') {
+        integral = false;
+        pos++;
+        if (pos == end || !isDigit(*pos)) {
+            return fail("invalid number, missing fraction");
+        }
+        const char* fractionStart = pos;
+        pos = jsonScanner.scanDigits(pos, end, mantissa);
+        digits += pos - fractionStart;
+        exponent -= pos - fractionStart;
+    }
+
+    if (pos < end && (*pos == 'e' || *pos == 'E')) {
+        integral = false;
+        pos++;
+        bool negativeExponent = false;
+        if (pos < end && (*pos == '+' || *pos == '-')) {
+            negativeExponent = *pos == '-';
+            pos++;
+        }
+        if (pos == end || !isDigit(*pos)) {
+            return fail("invalid number, missing exponent");
+        }
+        int e = 0;
+        while (pos < end && isDigit(*pos)) {
+            if (e < 100000) {
+                e = e * 10 + (*pos - '0');
+            }
+            pos++;
+        }
+        exponent += negativeExponent ? -e : e;
+    }
+
+    // up to 18 digits always fit into an integer
+    if (integral && digits <= 18) {
+        integer = negative ? -static_cast<Value::Integer>(mantissa) : static_cast<Value::Integer>(mantissa);
+
+        return true;
+    }
+
+    // a mantissa of up to 53 bits scaled by an exact power of ten is rounded once, so the result is exact
+#if FLT_EVAL_METHOD == 0
+    if (!integral && digits <= 19 && mantissa <= (1ull << 53) && exponent >= -22 && exponent <= 22) {
+        f = mantissa;
+        f = (exponent < 0) ? f / powersOf10[-exponent] : f * powersOf10[exponent];
+        f = negative ? -f : f;
+
+        return true;
+    }
+#endif
+
+    bool ok;
+    QByteArray number = QByteArray::fromRawData(start, pos - start);
+    if (integral) {
+        integer = number.toLongLong(&ok);
+        if (ok) {
+            return true;
+        }
+    }
+
+    // QByteArray::toDouble doesn't depend on the locale, unlike strtod
+    f = number.toDouble(&ok);
+    if (!ok) {
+        return fail("invalid number");
+    }
+    integral = false;
+
+    return true;
+}
+
+bool ValueJsonReader::readString(QString& string) {
+    pos++;
+
+    // strings without escapes are decoded straight from the input
+    const char* start = pos;
+    pos = jsonScanner.scanString(pos, end);
+    if (pos < end && *pos == '"') {
+        string = QString::fromUtf8(start, pos - start);
+        pos++;
+
+        return true;
+    }
+
+    // otherwise the runs between escapes are collected in the buffer
+    buffer.assign(start, pos - start);
+    while (pos < end) {
+        if (*pos == '"') {
+            string = QString::fromUtf8(buffer.data(), buffer.size());
+            pos++;
+
+            return true;
+        } else if (*pos != '\\') {
+            return fail("invalid control character in string");
+        }
+
+        if (!readEscape()) {
+            return false;
+        }
+
+        start = pos;
+        pos = jsonScanner.scanString(pos, end);
+        buffer.append(start, pos - start);
+    }
+
+    return fail("unterminated string");
+}
+
+bool ValueJsonReader::readEscape() {
+    pos++;
+    if (pos == end) {
+        return fail("unterminated string");
+    }
+
+    switch (*pos++) {
+    case '"':
+        buffer += '"';
+        break;
+    case '\\':
+        buffer += '\\';
+        break;
+    case '/':
+        buffer += '/';
+        break;
+    case 'b':
+        buffer += '\b';
+        break;
+    case 'f':
+        buffer += '\f';
+        break;
+    case 'n':
+        buffer += '\n';
+        break;
+    case 'r':
+        buffer += '\r';
+        break;
+    case 't':
+        buffer += '\t';
+        break;
+    case 'u': {
+        uint code;
+        if (!readHex(pos, code)) {
+            pos--;
+
+            return fail("invalid unicode escape");
+        }
+        pos += 4;
+
+        // characters outside the BMP are escaped as surrogate pairs, unpaired surrogates are replaced
+        if (code >= 0xDC00 && code <= 0xDFFF) {
+            code = 0xFFFD;
+        } else if (code >= 0xD800 && code <= 0xDBFF) {
+            uint low;
+            if (end - pos >= 6 && pos[0] == '\\' && pos[1] == 'u' && readHex(pos + 2, low) && low >= 0xDC00 && low <= 0xDFFF) {
+                code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                pos += 6;
+            } else {
+                code = 0xFFFD;
+            }
+        }
+
+        appendUtf8(buffer, code);
+        break;
+    }
+    default:
+        pos--;
+
+        return fail("invalid escape sequence");
+    }
+
+    return true;
+}
+
+bool ValueJsonReader::readHex(const char* p, uint& code) const {
+    if (end - p < 4) {
+        return false;
+    }
+
+    code = 0;
+    for (int i = 0; i < 4; i++) {
+        char c = p[i];
+        code <<= 4;
+        if (c >= '0' && c <= '9') {
+            code |= c - '0';
+        } else if (c >= 'a' && c <= 'f') {
+            code |= c - 'a' + 10;
+        } else if (c >= 'A' && c <= 'F') {
+            code |= c - 'A' + 10;
+        } else {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void unpackNumbers(Value::Array& array, const Value::IntegerArray& integers, const Value::FloatArray& floats, int count) {
+    array.reserve(count);
+    for (int i = 0; i < integers.size(); i++) {
+        array.append(Value(integers.at(i)));
+    }
+    for (int i = 0; i < floats.size(); i++) {
+        array.append(Value(floats.at(i)));
+    }
+}
+
+bool ValueJsonReader::readArray(Value& value) {
+    if (++depth > maxDepth) {
+        return fail("maximum nesting depth exceeded");
+    }
+    pos++;
+
+    Value::Array array;
+    Value::IntegerArray integers;
+    Value::FloatArray floats;
+    bool packed = false;
+    skipWhitespace();
+    if (pos < end && *pos == ']') {
+        pos++;
+    } else {
+        // flat arrays of numbers are counted ahead and stored packed, unless integers and floats are mixed
+        int count = 0;
+        if (pos < end && (isDigit(*pos) || *pos == '-')) {
+            int commas = 0;
+            const char* close = jsonScanner.scanArray(pos, end, commas);
+            if (close < end && *close == ']') {
+                count = commas + 1;
+                packed = true;
+            }
+        }
+
+        while (true) {
+            skipWhitespace();
+            if (packed && pos < end && (isDigit(*pos) || *pos == '-')) {
+                // numbers are decoded straight into the packed array, there is no Value per element
+                Value::Integer integer;
+                Value::Float f;
+                bool integral;
+                if (!readNumber(integer, f, integral)) {
+                    return false;
+                }
+
+                if (integral && floats.isEmpty()) {
+                    if (integers.isEmpty()) {
+                        integers.reserve(count);
+                    }
+                    integers.append(integer);
+                } else if (!integral && integers.isEmpty()) {
+                    if (floats.isEmpty()) {
+                        floats.reserve(count);
+                    }
+                    floats.append(f);
+                } else {
+                    packed = false;
+                    unpackNumbers(array, integers, floats, count);
+                    array.append(integral ? Value(integer) : Value(f));
+                }
+            } else if (packed) {
+                // literals between the numbers, the array is stored unpacked
+                packed = false;
+                unpackNumbers(array, integers, floats, count);
+                array.append(Value());
+                if (!readValue(array.last())) {
+                    return false;
+                }
+            } else {
+                array.append(Value());
+                if (!readValue(array.last())) {
+                    return false;
+                }
+            }
+
+            skipWhitespace();
+            if (pos == end) {
+                return fail("unterminated array");
+            } else if (*pos == ',') {
+                pos++;
+            } else if (*pos == ']') {
+                pos++;
+                break;
+            } else {
+                return fail("expected ',' or ']'");
+            }
+        }
+    }
+    depth--;
+
+    if (!packed) {
+        value = std::move(array);
+    } else if (!floats.isEmpty()) {
+        value = std::move(floats);
+    } else {
+        value = std::move(integers);
+    }
+
+    return true;
+}
+
+bool ValueJsonReader::readObject(Value& value) {
+    if (++depth > maxDepth) {
+        return fail("maximum nesting depth exceeded");
+    }
+    pos++;
+
+    Value::Object object;
+    skipWhitespace();
+    if (pos < end && *pos == '}') {
+        pos++;
+    } else {
+        while (true) {
+            skipWhitespace();
+            if (pos == end || *pos != '"') {
+                return fail("expected object key");
+            }
+
+            QString key;
+            if (!readString(key)) {
+                return false;
+            }
+
+            skipWhitespace();
+            if (pos == end || *pos != ':') {
+                return fail("expected ':'");
+            }
+            pos++;
+
+            if (!readValue(object[key])) {
+                return false;
+            }
+
+            skipWhitespace();
+            if (pos == end) {
+                return fail("unterminated object");
+            } else if (*pos == ',') {
+                pos++;
+            } else if (*pos == '}') {
+                pos++;
+                break;
+            } else {
+                return fail("expected ',' or '}'");
+            }
+        }
+    }
+    depth--;
+
+    value = std::move(object);
+
+    return true;
+}
+
+void ValueJsonReader::skipWhitespace() {
+    while (pos < end && (*pos == ' ' || *pos == '\n' || *pos == '\r' || *pos == '\t')) {
+        pos++;
+    }
+}
+
+bool ValueJsonReader::fail(const QString& message) {
+    error = QString("%1 at offset %2").arg(message).arg((qlonglong)(pos - begin));
+
+    return false;
+}
+
+/*
+ * ValueJsonWriter
+ */
+ValueJsonWriter::ValueJsonWriter(QByteArray& json, bool pretty) :
+    json(json),
+    pretty(pretty),
+    indent(0) {
+
+}
+
+void ValueJsonWriter::write(const Value& value) {
+    indent = 0;
+    writeValue(value);
+
+    if (pretty) {
+        json.append('\n');
+    }
+}
+
+void ValueJsonWriter::writeValue(const Value& value) {
+    switch (value.getType()) {
+    case Value::TYPE_BOOLEAN:
+        json.append(value.getBoolean() ? "true" : "false");
+        break;
+    case Value::TYPE_INTEGER:
+        writeInteger(value.getInteger());
+        break;
+    case Value::TYPE_FLOAT:
+        writeFloat(value.getFloat());
+        break;
+    case Value::TYPE_STRING:
+        writeString(value.getStringRef());
+        break;
+    case Value::TYPE_ARRAY: {
+        // packed arrays are written straight from their vector, without unpacking them
+        Value::Type packed = value.getPackedType();
+        const Value::IntegerArray& integers = value.getIntegerArrayRef();
+        const Value::FloatArray& floats = value.getFloatArrayRef();
+        const Value::Array* array = (packed == Value::TYPE_UNDEFINED) ? &value.getArrayRef() : NULL;
+        int size = value.size();
+        json.append('[');
+        if (size > 0) {
+            indent++;
+            for (int i = 0; i < size; i++) {
+                if (i > 0) {
+                    json.append(',');
+                }
+                writeNewline();
+                if (packed == Value::TYPE_INTEGER) {
+                    writeInteger(integers.at(i));
+                } else if (packed == Value::TYPE_FLOAT) {
+                    writeFloat(floats.at(i));
+                } else {
+                    writeValue(array->at(i));
+                }
+            }
+            indent--;
+            writeNewline();
+        }
+        json.append(']');
+        break;
+    }
+    case Value::TYPE_OBJECT: {
+        QVector<Value::Object::const_iterator> object = sortByKey(value.getObjectRef());
+        json.append('{');
+        if (!object.isEmpty()) {
+            indent++;
+            for (int i = 0; i < object.size(); i++) {
+                if (i > 0) {
+                    json.append(',');
+                }
+                writeNewline();
+                writeString(object[i].key());
+                json.append(pretty ? " : " : ":");
+                writeValue(object[i].value());
+            }
+            indent--;
+            writeNewline();
+        }
+        json.append('}');
+        break;
+    }
+    default:
+        json.append("null");
+        break;
+    }
+}
+
+static int formatFloat(char* buffer, int size, const char* format, Value::Float value) {
+    int n = snprintf(buffer, size, format, value);
+
+    // the decimal separator of printf depends on the locale
+    for (int i = 0; i < n; i++) {
+        if (buffer[i] == ',') {
+            buffer[i] = '.';
+        }
+    }
+
+    return n;
+}
+
+void ValueJsonWriter::writeInteger(Value::Integer value) {
+    char buffer[32];
+    int n = snprintf(buffer, sizeof(buffer), "%ld", value);
+    json.append(buffer, n);
+}
+
+void ValueJsonWriter::writeFloat(Value::Float value) {
+    // JSON has no representation for NaN and infinity
+    if (!std::isfinite(value)) {
+        json.append("null");
+
+        return;
+    }
+
+    // use 15 significant digits if they read back as the same value, 17 digits otherwise
+    char buffer[32];
+    int n = formatFloat(buffer, sizeof(buffer), "%.15g", value);
+    if (QByteArray::fromRawData(buffer, n).toDouble() != value) {
+        n = formatFloat(buffer, sizeof(buffer), "%.17g", value);
+    }
+    json.append(buffer, n);
+
+    // keep the value a float when it is read back
+    if (strpbrk(buffer, ".eE") == NULL) {
+        json.append(".0");
+    }
+}
+
+void ValueJsonWriter::writeString(const QString& string) {
+    json.append('"');
+
+    const QChar* c = string.constData();
+    const QChar* e = c + string.size();
+    for (; c < e; c++) {
+        ushort u = c->unicode();
+        if (u < 0x80) {
+            switch (u) {
+            case '"':
+                json.append("\\\"");
+                break;
+            case '\\':
+                json.append("\\\\");
+                break;
+            case '\b':
+                json.append("\\b");
+                break;
+            case '\f':
+                json.append("\\f");
+                break;
+            case '\n':
+                json.append("\\n");
+                break;
+            case '\r':
+                json.append("\\r");
+                break;
+            case '\t':
+                json.append("\\t");
+                break;
+            default:
+                if (u < 0x20) {
+                    char buffer[8];
+                    int n = snprintf(buffer, sizeof(buffer), "\\u%04x", u);
+                    json.append(buffer, n);
+                } else {
+                    json.append((char)u);
+                }
+                break;
+            }
+        } else if (u < 0x800) {
+            json.append((char)(0xC0 | (u >> 6)));
+            json.append((char)(0x80 | (u & 0x3F)));
+        } else if (QChar::isHighSurrogate(u) && c + 1 < e && c[1].isLowSurrogate()) {
+            uint code = QChar::surrogateToUcs4(u, c[1].unicode());
+            c++;
+            json.append((char)(0xF0 | (code >> 18)));
+            json.append((char)(0x80 | ((code >> 12) & 0x3F)));
+            json.append((char)(0x80 | ((code >> 6) & 0x3F)));
+            json.append((char)(0x80 | (code & 0x3F)));
+        } else if (QChar::isSurrogate(u)) {
+            // unpaired surrogates can't be encoded as UTF-8
+            char buffer[8];
+            int n = snprintf(buffer, sizeof(buffer), "\\u%04x", u);
+            json.append(buffer, n);
+        } else {
+            json.append((char)(0xE0 | (u >> 12)));
+            json.append((char)(0x80 | ((u >> 6) & 0x3F)));
+            json.append((char)(0x80 | (u & 0x3F)));
+        }
+    }
+
+    json.append('"');
+}
+
+void ValueJsonWriter::writeNewline() {
+    if (pretty) {
+        json.append('\n');
+        for (int i = 0; i < indent * 3; i++) {
+            json.append(' ');
+        }
+    }
+}
+
+/*
+ * ValueCborReader
+ */
+static Value::Float decodeHalf(quint16 half) {
+    int exponent = (half >> 10) & 0x1F;
+    int mantissa = half & 0x3FF;
+    Value::Float value;
+    if (exponent == 0) {
+        value = std::ldexp((Value::Float)mantissa, -24);
+    } else if (exponent != 31) {
+        value = std::ldexp((Value::Float)(mantissa + 1024), exponent - 25);
+    } else {
+        value = (mantissa == 0) ? INFINITY : NAN;
+    }
+
+    return (half & 0x8000) ? -value : value;
+}
+
+ValueCborReader::ValueCborReader(const char* cbor, int size) :
+    begin(reinterpret_cast<const unsigned char*>(cbor)),
+    pos(begin),
+    end(begin + size),
+    depth(0),
+    truncated(false) {
+
+}
+
+bool ValueCborReader::read(Value& value) {
+    depth = 0;
+    truncated = false;
+    error.clear();
+
+    // the value is only replaced if the whole item is valid, the position only advances past valid items
+    const unsigned char* start = pos;
+    Value result;
+    if (!readValue(result)) {
+        pos = start;
+
+        return false;
+    }
+
+    value = std::move(result);
+
+    return true;
+}
+
+int ValueCborReader::getPosition() const {
+    return pos - begin;
+}
+
+bool ValueCborReader::isTruncated() const {
+    return truncated;
+}
+
+const QString& ValueCborReader::getError() const {
+    return error;
+}
+
+bool ValueCborReader::readValue(Value& value) {
+    int major;
+    int info;
+    quint64 argument;
+    if (!readHead(major, info, argument)) {
+        return false;
+    }
+
+    // tags other than typed arrays (RFC 8746) are ignored, chains of them are skipped without recursing
+    while (major == 6 && !(argument >= 64 && argument <= 87)) {
+        if (!readHead(major, info, argument)) {
+            return false;
+        }
+    }
+
+    const quint64 maxInteger = std::numeric_limits<Value::Integer>::max();
+    switch (major) {
+    case 0:
+        if (argument > maxInteger) {
+            value = (Value::Float)argument;
+        } else {
+            value = (Value::Integer)argument;
+        }
+
+        return true;
+    case 1:
+        if (argument > maxInteger) {
+            value = -1.0 - (Value::Float)argument;
+        } else {
+            value = -1 - (Value::Integer)argument;
+        }
+
+        return true;
+    case 2: {
+        // rosbridge encodes uint8[] as byte strings
+        if (!readLength(argument)) {
+            return false;
+        }
+
+        Value::IntegerArray array(argument);
+        for (quint64 i = 0; i < argument; i++) {
+            array[i] = *pos++;
+        }
+        value = std::move(array);
+
+        return true;
+    }
+    case 3: {
+        if (!readLength(argument)) {
+            return false;
+        }
+
+        value = QString::fromUtf8(reinterpret_cast<const char*>(pos), argument);
+        pos += argument;
+
+        return true;
+    }
+    case 4: {
+        if (++depth > maxDepth) {
+            return fail("maximum nesting depth exceeded");
+        }
+
+        // every item takes at least one byte
+        if (!readLength(argument)) {
+            return false;
+        }
+
+        Value::Array array;
+        array.reserve(argument);
+        for (quint64 i = 0; i < argument; i++) {
+            array.append(Value());
+            if (!readValue(array.last())) {
+                return false;
+            }
+        }
+        depth--;
+        value = std::move(array);
+
+        return true;
+    }
+    case 5: {
+        if (++depth > maxDepth) {
+            return fail("maximum nesting depth exceeded");
+        }
+
+        Value::Object object;
+        for (quint64 i = 0; i < argument; i++) {
+            int keyMajor;
+            int keyInfo;
+            quint64 keyLength;
+            if (!readHead(keyMajor, keyInfo, keyLength)) {
+                return false;
+            }
+
+            if (keyMajor != 3) {
+                return fail("object keys must be text strings");
+            }
+
+            if (!readLength(keyLength)) {
+                return false;
+            }
+
+            QString key = QString::fromUtf8(reinterpret_cast<const char*>(pos), keyLength);
+            pos += keyLength;
+
+            if (!readValue(object[key])) {
+                return false;
+            }
+        }
+        depth--;
+        value = std::move(object);
+
+        return true;
+    }
+    case 6:
+        return readTypedArray(value, argument);
+    default:
+        switch (info) {
+        case 20:
+            value = false;
+
+            return true;
+        case 21:
+            value = true;
+
+            return true;
+        case 22:
+            value.null();
+
+            return true;
+        case 23:
+            value.undefined();
+
+            return true;
+        case 25:
+            value = decodeHalf(argument);
+
+            return true;
+        case 26: {
+            quint32 bits = argument;
+            float f;
+            memcpy(&f, &bits, sizeof(f));
+            value = f;
+
+            return true;
+        }
+        case 27: {
+            Value::Float f;
+            memcpy(&f, &argument, sizeof(f));
+            value = f;
+
+            return true;
+        }
+        default:
+            return fail("unsupported simple value");
+        }
+    }
+}
+
+bool ValueCborReader::readHead(int& major, int& info, quint64& argument) {
+    if (pos == end) {
+        return truncate();
+    }
+
+    major = *pos >> 5;
+    info = *pos & 0x1F;
+    pos++;
+
+    if (info < 24) {
+        argument = info;
+    } else if (info <= 27) {
+        int size = 1 << (info - 24);
+        if (end - pos < size) {
+            return truncate();
+        }
+
+        argument = 0;
+        for (int i = 0; i < size; i++) {
+            argument = (argument << 8) | *pos++;
+        }
+    } else if (info == 31) {
+        return fail("indefinite length items are not supported");
+    } else {
+        return fail("invalid additional information");
+    }
+
+    return true;
+}
+
+bool ValueCborReader::readLength(quint64 length) {
+    if (length > (quint64)(end - pos)) {
+        return truncate();
+    }
+
+    return true;
+}
+
+bool ValueCborReader::readTypedArray(Value& value, quint64 tag) {
+    int type = tag - 64;
+    bool isFloat = type & 16;
+    bool isSigned = !isFloat && (type & 8);
+    bool isLittleEndian = type & 4;
+    int size;
+    if (isFloat) {
+        size = 2 << (type & 3);
+    } else {
+        size = 1 << (type & 3);
+        // clamped uint8 has no endianness
+        if (type == 4) {
+            isLittleEndian = false;
+        } else if (type == 12) {
+            return fail("invalid typed array tag");
+        }
+    }
+
+    if (size > 8) {
+        return fail("128 bit floats are not supported");
+    }
+
+    int major;
+    int info;
+    quint64 length;
+    if (!readHead(major, info, length)) {
+        return false;
+    }
+
+    if (major != 2 || length % size != 0) {
+        return fail("typed arrays must be byte strings of whole elements");
+    }
+
+    if (!readLength(length)) {
+        return false;
+    }
+
+    // typed arrays are stored packed. Unsigned 64 bit elements beyond the integer range become floats, arrays
+    // containing such elements fall back to a plain array.
+    Value::IntegerArray integers;
+    Value::FloatArray floats;
+    bool mixed = false;
+    if (isFloat) {
+        floats.reserve(length / size);
+    } else {
+        integers.reserve(length / size);
+    }
+    for (quint64 i = 0; i < length; i += size) {
+        quint64 bits = 0;
+        for (int j = 0; j < size; j++) {
+            int shift = isLittleEndian ? j * 8 : (size - 1 - j) * 8;
+            bits |= (quint64)pos[j] << shift;
+        }
+        pos += size;
+
+        if (isFloat) {
+            if (size == 2) {
+                floats.append(decodeHalf(bits));
+            } else if (size == 4) {
+                quint32 b = bits;
+                float f;
+                memcpy(&f, &b, sizeof(f));
+                floats.append(f);
+            } else {
+                Value::Float f;
+                memcpy(&f, &bits, sizeof(f));
+                floats.append(f);
+            }
+        } else if (isSigned) {
+            // sign extend
+            int shift = 64 - size * 8;
+            integers.append((Value::Integer)((qint64)(bits << shift) >> shift));
+        } else if (bits > (quint64)std::numeric_limits<Value::Integer>::max()) {
+            // keep the position of the element, it is turned into a float below
+            mixed = true;
+            integers.append(std::numeric_limits<Value::Integer>::min());
+            floats.append((Value::Float)bits);
+        } else {
+            integers.append((Value::Integer)bits);
+        }
+    }
+
+    if (isFloat) {
+        value = std::move(floats);
+    } else if (!mixed) {
+        value = std::move(integers);
+    } else {
+        // element values are non negative, so the marker can't collide with a real element
+        Value::Array array;
+        array.reserve(integers.size());
+        for (int i = 0, j = 0; i < integers.size(); i++) {
+            if (integers.at(i) == std::numeric_limits<Value::Integer>::min()) {
+                array.append(Value(floats.at(j++)));
+            } else {
+                array.append(Value(integers.at(i)));
+            }
+        }
+        value = std::move(array);
+    }
+
+    return true;
+}
+
+bool ValueCborReader::fail(const QString& message) {
+    error = QString("%1 at offset %2").arg(message).arg((qlonglong)(pos - begin));
+
+    return false;
+}
+
+bool ValueCborReader::truncate() {
+    truncated = true;
+
+    return fail("unexpected end of data");
+}
+
+/*
+ * ValueCborWriter
+ */
+ValueCborWriter::ValueCborWriter(QByteArray& cbor) :
+    cbor(cbor) {
+
+}
+
+void ValueCborWriter::write(const Value& value) {
+    switch (value.getType()) {
+    case Value::TYPE_UNDEFINED:
+        cbor.append((char)0xF7);
+        break;
+    case Value::TYPE_BOOLEAN:
+        cbor.append((char)(value.getBoolean() ? 0xF5 : 0xF4));
+        break;
+    case Value::TYPE_INTEGER:
+        writeInteger(value.getInteger());
+        break;
+    case Value::TYPE_FLOAT:
+        writeFloat(value.getFloat());
+        break;
+    case Value::TYPE_STRING:
+        writeString(value.getStringRef());
+        break;
+    case Value::TYPE_ARRAY: {
+        Value::Type packed = value.getPackedType();
+        if (packed == Value::TYPE_INTEGER) {
+            const Value::IntegerArray& integers = value.getIntegerArrayRef();
+            writeHead(4, integers.size());
+            for (int i = 0; i < integers.size(); i++) {
+                writeInteger(integers.at(i));
+            }
+        } else if (packed == Value::TYPE_FLOAT) {
+            const Value::FloatArray& floats = value.getFloatArrayRef();
+            writeHead(4, floats.size());
+            for (int i = 0; i < floats.size(); i++) {
+                writeFloat(floats.at(i));
+            }
+        } else {
+            const Value::Array& array = value.getArrayRef();
+            writeHead(4, array.size());
+            for (int i = 0; i < array.size(); i++) {
+                write(array.at(i));
+            }
+        }
+        break;
+    }
+    case Value::TYPE_OBJECT: {
+        QVector<Value::Object::const_iterator> object = sortByKey(value.getObjectRef());
+        writeHead(5, object.size());
+        for (int i = 0; i < object.size(); i++) {
+            writeString(object[i].key());
+            write(object[i].value());
+        }
+        break;
+    }
+    default:
+        cbor.append((char)0xF6);
+        break;
+    }
+}
+
+void ValueCborWriter::writeArray(int size) {
+    writeHead(4, size);
+}
+
+void ValueCborWriter::writeHead(int major, quint64 argument) {
+    int info;
+    int size;
+    if (argument < 24) {
+        info = argument;
+        size = 0;
+    } else if (argument <= 0xFF) {
+        info = 24;
+        size = 1;
+    } else if (argument <= 0xFFFF) {
+        info = 25;
+        size = 2;
+    } else if (argument <= 0xFFFFFFFF) {
+        info = 26;
+        size = 4;
+    } else {
+        info = 27;
+        size = 8;
+    }
+
+    cbor.append((char)((major << 5) | info));
+    for (int i = size - 1; i >= 0; i--) {
+        cbor.append((char)(argument >> (i * 8)));
+    }
+}
+
+void ValueCborWriter::writeInteger(Value::Integer value) {
+    if (value >= 0) {
+        writeHead(0, value);
+    } else {
+        writeHead(1, -(value + 1));
+    }
+}
+
+void ValueCborWriter::writeFloat(Value::Float value) {
+    // floats that survive the conversion to single precision take half the space
+    if (value != value || (std::fabs(value) <= FLT_MAX && (float)value == value)) {
+        float f = value;
+        quint32 bits;
+        memcpy(&bits, &f, sizeof(bits));
+        cbor.append((char)0xFA);
+        for (int i = 3; i >= 0; i--) {
+            cbor.append((char)(bits >> (i * 8)));
+        }
+    } else {
+        quint64 bits;
+        memcpy(&bits, &value, sizeof(bits));
+        cbor.append((char)0xFB);
+        for (int i = 7; i >= 0; i--) {
+            cbor.append((char)(bits >> (i * 8)));
+        }
+    }
+}
+
+void ValueCborWriter::writeString(const QString& string) {
+    QByteArray utf8 = string.toUtf8();
+    writeHead(3, utf8.size());
+    cbor.append(utf8);
+}
+
+/*
+ * ValueView
+ */
+// views are checked for a valid structure once when they are created, so the helpers below don't need to validate
+// the parts of the buffer they walk again
+static const char* skipJsonWhitespace(const char* p, const char* end) {
+    while (p < end && (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t')) {
+        p++;
+    }
+
+    return p;
+}
+
+static const char* skipJsonString(const char* p, const char* end) {
+    p++;
+    while (true) {
+        p = jsonScanner.scanString(p, end);
+        if (p == end) {
+            return NULL;
+        } else if (*p == '"') {
+            return p + 1;
+        } else if (*p == '\\' && end - p >= 2) {
+            p += 2;
+        } else {
+            return NULL;
+        }
+    }
+}
+
+static const char* skipJson(const char* p, const char* end, int depth) {
+    if (p == end) {
+        return NULL;
+    }
+
+    switch (*p) {
+    case '"':
+        return skipJsonString(p, end);
+    case '[':
+    case '{': {
+        if (depth == 0) {
+            return NULL;
+        }
+
+        bool object = *p == '{';
+        char close = object ? '}' : ']';
+        p = skipJsonWhitespace(p + 1, end);
+        if (p < end && *p == close) {
+            return p + 1;
+        }
+
+        while (true) {
+            if (object) {
+                if (p == end || *p != '"') {
+                    return NULL;
+                }
+                p = skipJsonString(p, end);
+                if (p == NULL) {
+                    return NULL;
+                }
+                p = skipJsonWhitespace(p, end);
+                if (p == end || *p != ':') {
+                    return NULL;
+                }
+                p = skipJsonWhitespace(p + 1, end);
+            }
+
+            p = skipJson(p, end, depth - 1);
+            if (p == NULL) {
+                return NULL;
+            }
+
+            p = skipJsonWhitespace(p, end);
+            if (p == end) {
+                return NULL;
+            } else if (*p == ',') {
+                p = skipJsonWhitespace(p + 1, end);
+            } else if (*p == close) {
+                return p + 1;
+            } else {
+                return NULL;
+            }
+        }
+    }
+    case 't':
+        return (end - p >= 4 && memcmp(p, "true", 4) == 0) ? p + 4 : NULL;
+    case 'f':
+        return (end - p >= 5 && memcmp(p, "false", 5) == 0) ? p + 5 : NULL;
+    case 'n':
+        return (end - p >= 4 && memcmp(p, "null", 4) == 0) ? p + 4 : NULL;
+    default: {
+        // the number itself is checked when it is read
+        const char* start = p;
+        while (p < end && (isDigit(*p) || *p == '-' || *p == '+' || *p == '.' || *p == 'e' || *p == 'E')) {
+            p++;
+        }
+
+        return (p != start) ? p : NULL;
+    }
+    }
+}
+
+static const unsigned char* readCborHead(const unsigned char* p, const unsigned char* end, int& major, int& info, quint64& argument, bool& truncated) {
+    if (p == end) {
+        truncated = true;
+
+        return NULL;
+    }
+
+    major = *p >> 5;
+    info = *p & 0x1F;
+    p++;
+
+    if (info < 24) {
+        argument = info;
+    } else if (info <= 27) {
+        int size = 1 << (info - 24);
+        if (end - p < size) {
+            truncated = true;
+
+            return NULL;
+        }
+
+        argument = 0;
+        for (int i = 0; i < size; i++) {
+            argument = (argument << 8) | *p++;
+        }
+    } else {
+        return NULL;
+    }
+
+    return p;
+}
+
+static const unsigned char* skipCbor(const unsigned char* p, const unsigned char* end, int depth, bool& truncated) {
+    int major;
+    int info;
+    quint64 argument;
+    p = readCborHead(p, end, major, info, argument, truncated);
+
+    // tags only prefix the item, chains of them are skipped without recursing
+    while (p != NULL && major == 6) {
+        p = readCborHead(p, end, major, info, argument, truncated);
+    }
+
+    if (p == NULL) {
+        return NULL;
+    }
+
+    switch (major) {
+    case 2:
+    case 3:
+        if (argument > (quint64)(end - p)) {
+            truncated = true;
+
+            return NULL;
+        }
+
+        return p + argument;
+    case 4:
+    case 5: {
+        if (depth == 0) {
+            return NULL;
+        }
+
+        quint64 items = (major == 5) ? argument * 2 : argument;
+        for (quint64 i = 0; i < items && p != NULL; i++) {
+            p = skipCbor(p, end, depth - 1, truncated);
+        }
+
+        return p;
+    }
+    default:
+        return p;
+    }
+}
+
+// tags other than typed arrays don't change the value
+static const unsigned char* untagCbor(const unsigned char* p, const unsigned char* end, int& major, quint64& argument) {
+    int info;
+    bool truncated = false;
+    major = -1;
+    const unsigned char* content = readCborHead(p, end, major, info, argument, truncated);
+    while (content != NULL && major == 6 && !(argument >= 64 && argument <= 87)) {
+        content = readCborHead(content, end, major, info, argument, truncated);
+    }
+
+    return content;
+}
+
+// compares UTF-8 with UTF-16 without converting either of them
+static bool equalsUtf8(const char* p, int size, const QString& string) {
+    const unsigned char* s = reinterpret_cast<const unsigned char*>(p);
+    const unsigned char* end = s + size;
+    const ushort* u = string.utf16();
+    const ushort* uEnd = u + string.size();
+    while (s < end) {
+        uint code;
+        int length;
+        if (*s < 0x80) {
+            code = *s;
+            length = 1;
+        } else if ((*s & 0xE0) == 0xC0) {
+            code = *s & 0x1F;
+            length = 2;
+        } else if ((*s & 0xF0) == 0xE0) {
+            code = *s & 0x0F;
+            length = 3;
+        } else if ((*s & 0xF8) == 0xF0) {
+            code = *s & 0x07;
+            length = 4;
+        } else {
+            return QString::fromUtf8(p, size) == string;
+        }
+
+        if (end - s < length) {
+            return QString::fromUtf8(p, size) == string;
+        }
+        for (int i = 1; i < length; i++) {
+            if ((s[i] & 0xC0) != 0x80) {
+                return QString::fromUtf8(p, size) == string;
+            }
+            code = (code << 6) | (s[i] & 0x3F);
+        }
+        s += length;
+
+        if (code >= 0x10000) {
+            if (uEnd - u < 2 || u[0] != QChar::highSurrogate(code) || u[1] != QChar::lowSurrogate(code)) {
+                return false;
+            }
+            u += 2;
+        } else {
+            if (u == uEnd || *u != code) {
+                return false;
+            }
+            u++;
+        }
+    }
+
+    return u == uEnd;
+}
+
+ValueView::ValueView() :
+    begin(NULL),
+    end(NULL),
+    encoding(ENCODING_NONE),
+    truncated(false) {
+
+}
+
+ValueView::ValueView(const char* begin, const char* end, Encoding encoding) :
+    begin(begin),
+    end(end),
+    encoding(encoding),
+    truncated(false) {
+
+}
+
+bool ValueView::fromJson(const char* json, int size) {
+    *this = ValueView();
+
+    const char* p = json;
+    const char* e = json + size;
+    if (e - p >= 3 && memcmp(p, "\xEF\xBB\xBF", 3) == 0) {
+        p += 3;
+    }
+
+    p = skipJsonWhitespace(p, e);
+    const char* valueEnd = skipJson(p, e, maxDepth);
+    if (valueEnd == NULL || skipJsonWhitespace(valueEnd, e) != e) {
+        return false;
+    }
+
+    *this = ValueView(p, valueEnd, ENCODING_JSON);
+
+    return true;
+}
+
+bool ValueView::fromBinary(const char* cbor, int size) {
+    *this = ValueView();
+
+    // only the first item is viewed, the size tells where the next one starts
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(cbor);
+    const unsigned char* itemEnd = skipCbor(p, p + size, maxDepth, truncated);
+    if (itemEnd == NULL) {
+        return false;
+    }
+
+    *this = ValueView(cbor, reinterpret_cast<const char*>(itemEnd), ENCODING_BINARY);
+
+    return true;
+}
+
+int ValueView::getSize() const {
+    return end - begin;
+}
+
+bool ValueView::isTruncated() const {
+    return truncated;
+}
+
+bool ValueView::isValid() const {
+    return encoding != ENCODING_NONE;
+}
+
+bool ValueView::isUndefined() const {
+    return getType() == Value::TYPE_UNDEFINED;
+}
+
+bool ValueView::isNull() const {
+    return getType() == Value::TYPE_NULL;
+}
+
+bool ValueView::isBoolean() const {
+    return getType() == Value::TYPE_BOOLEAN;
+}
+
+bool ValueView::isInteger() const {
+    return getType() == Value::TYPE_INTEGER;
+}
+
+bool ValueView::isFloat() const {
+    return getType() == Value::TYPE_FLOAT;
+}
+
+bool ValueView::isString() const {
+    return getType() == Value::TYPE_STRING;
+}
+
+bool ValueView::isArray() const {
+    return getType() == Value::TYPE_ARRAY;
+}
+
+bool ValueView::isObject() const {
+    return getType() == Value::TYPE_OBJECT;
+}
+
+Value::Type ValueView::getType() const {
+    if (encoding == ENCODING_JSON) {
+        switch (*begin) {
+        case '{':
+            return Value::TYPE_OBJECT;
+        case '[':
+            return Value::TYPE_ARRAY;
+        case '"':
+            return Value::TYPE_STRING;
+        default:
+            break;
+        }
+    } else if (encoding == ENCODING_BINARY) {
+        int major;
+        quint64 argument;
+        const unsigned char* p = reinterpret_cast<const unsigned char*>(begin);
+        untagCbor(p, p + getSize(), major, argument);
+        switch (major) {
+        case 2:
+        case 4:
+        case 6:
+            return Value::TYPE_ARRAY;
+        case 3:
+            return Value::TYPE_STRING;
+        case 5:
+            return Value::TYPE_OBJECT;
+        default:
+            break;
+        }
+    } else {
+        return Value::TYPE_UNDEFINED;
+    }
+
+    // scalars are read into an inlined value, which doesn't allocate
+    Value value;
+    if (!toValue(value)) {
+        return Value::TYPE_UNDEFINED;
+    }
+
+    return value.getType();
+}
+
+Value::Boolean ValueView::getBoolean(Value::Boolean defaultValue) const {
+    if (getType() != Value::TYPE_BOOLEAN) {
+        return defaultValue;
+    }
+
+    return toValue().getBoolean(defaultValue);
+}
+
+Value::Integer ValueView::getInteger(Value::Integer defaultValue) const {
+    if (getType() != Value::TYPE_INTEGER) {
+        return defaultValue;
+    }
+
+    return toValue().getInteger(defaultValue);
+}
+
+Value::Float ValueView::getFloat(Value::Float defaultValue) const {
+    if (getType() != Value::TYPE_FLOAT) {
+        return defaultValue;
+    }
+
+    return toValue().getFloat(defaultValue);
+}
+
+Value::String ValueView::getString(Value::String defaultValue) const {
+    if (getType() != Value::TYPE_STRING) {
+        return defaultValue;
+    }
+
+    return toValue().getString(defaultValue);
+}
+
+bool ValueView::toValue(Value& value) const {
+    if (encoding == ENCODING_JSON) {
+        ValueJsonReader reader(begin, getSize());
+
+        return reader.read(value);
+    } else if (encoding == ENCODING_BINARY) {
+        ValueCborReader reader(begin, getSize());
+
+        return reader.read(value);
+    }
+
+    return false;
+}
+
+Value ValueView::toValue() const {
+    Value value;
+    toValue(value);
+
+    return value;
+}
+
+int ValueView::size() const {
+    if (encoding == ENCODING_JSON) {
+        if (*begin != '[') {
+            return -1;
+        }
+
+        const char* p = skipJsonWhitespace(begin + 1, end);
+        int n = 0;
+        while (p < end && *p != ']') {
+            n++;
+            p = skipJsonWhitespace(skipJson(p, end, maxDepth), end);
+            if (p < end && *p == ',') {
+                p = skipJsonWhitespace(p + 1, end);
+            }
+        }
+
+        return n;
+    } else if (encoding == ENCODING_BINARY) {
+        int major;
+        quint64 argument;
+        const unsigned char* p = reinterpret_cast<const unsigned char*>(begin);
+        const unsigned char* content = untagCbor(p, p + getSize(), major, argument);
+        if (major == 2 || major == 4) {
+            return argument;
+        } else if (major == 6) {
+            // typed array, the element size is encoded in the tag
+            int type = argument - 64;
+            int elementSize = (type & 16) ? 2 << (type & 3) : 1 << (type & 3);
+            int info;
+            bool truncated = false;
+            readCborHead(content, p + getSize(), major, info, argument, truncated);
+
+            return argument / elementSize;
+        }
+    }
+
+    return -1;
+}
+
+bool ValueView::contains(const char* key) const {
+    return find(key, strlen(key), NULL).isValid();
+}
+
+bool ValueView::contains(const QString& key) const {
+    return find(NULL, 0, &key).isValid();
+}
+
+ValueView ValueView::operator[](const char* key) const {
+    return find(key, strlen(key), NULL);
+}
+
+ValueView ValueView::operator[](const QString& key) const {
+    return find(NULL, 0, &key);
+}
+
+ValueView ValueView::operator[](int i) const {
+    if (i < 0) {
+        return ValueView();
+    }
+
+    if (encoding == ENCODING_JSON) {
+        if (*begin != '[') {
+            return ValueView();
+        }
+
+        const char* p = skipJsonWhitespace(begin + 1, end);
+        while (p < end && *p != ']') {
+            const char* elementEnd = skipJson(p, end, maxDepth);
+            if (i-- == 0) {
+                return ValueView(p, elementEnd, ENCODING_JSON);
+            }
+
+            p = skipJsonWhitespace(elementEnd, end);
+            if (p < end && *p == ',') {
+                p = skipJsonWhitespace(p + 1, end);
+            }
+        }
+    } else if (encoding == ENCODING_BINARY) {
+        // elements of typed arrays and byte strings are only available through toValue
+        int major;
+        quint64 argument;
+        const unsigned char* e = reinterpret_cast<const unsigned char*>(end);
+        const unsigned char* p = untagCbor(reinterpret_cast<const unsigned char*>(begin), e, major, argument);
+        if (major != 4 || (quint64)i >= argument) {
+            return ValueView();
+        }
+
+        bool truncated = false;
+        for (; i > 0; i--) {
+            p = skipCbor(p, e, maxDepth, truncated);
+        }
+
+        return ValueView(reinterpret_cast<const char*>(p), reinterpret_cast<const char*>(skipCbor(p, e, maxDepth, truncated)), ENCODING_BINARY);
+    }
+
+    return ValueView();
+}
+
+bool ValueView::operator==(const char* other) const {
+    return getType() == Value::TYPE_STRING && equals(other, strlen(other), NULL);
+}
+
+bool ValueView::operator==(const QString& other) const {
+    return getType() == Value::TYPE_STRING && equals(NULL, 0, &other);
+}
+
+bool ValueView::operator==(const Value& other) const {
+    Value::Type t = other.getType();
+    if (t != getType()) {
+        return false;
+    }
+
+    switch (t) {
+    case Value::TYPE_STRING:
+        return equals(NULL, 0, &other.getStringRef());
+    default:
+        // scalars don't allocate, arrays and objects are compared decoded
+        return toValue() == other;
+    }
+}
+
+bool ValueView::operator!=(const char* other) const {
+    return !(*this == other);
+}
+
+bool ValueView::operator!=(const QString& other) const {
+    return !(*this == other);
+}
+
+bool ValueView::operator!=(const Value& other) const {
+    return !(*this == other);
+}
+
+ValueView ValueView::find(const char* key, int size, const QString* string) const {
+    if (encoding == ENCODING_JSON) {
+        if (*begin != '{') {
+            return ValueView();
+        }
+
+        const char* p = skipJsonWhitespace(begin + 1, end);
+        while (p < end && *p == '"') {
+            const char* keyEnd = skipJsonString(p, end);
+            ValueView k(p, keyEnd, ENCODING_JSON);
+
+            // skip ':'
+            p = skipJsonWhitespace(skipJsonWhitespace(keyEnd, end) + 1, end);
+            const char* valueEnd = skipJson(p, end, maxDepth);
+            if (k.equals(key, size, string)) {
+                return ValueView(p, valueEnd, ENCODING_JSON);
+            }
+
+            p = skipJsonWhitespace(valueEnd, end);
+            if (p < end && *p == ',') {
+                p = skipJsonWhitespace(p + 1, end);
+            }
+        }
+    } else if (encoding == ENCODING_BINARY) {
+        int major;
+        quint64 argument;
+        const unsigned char* e = reinterpret_cast<const unsigned char*>(end);
+        const unsigned char* p = untagCbor(reinterpret_cast<const unsigned char*>(begin), e, major, argument);
+        if (major != 5) {
+            return ValueView();
+        }
+
+        bool truncated = false;
+        for (quint64 i = 0; i < argument; i++) {
+            const unsigned char* keyEnd = skipCbor(p, e, maxDepth, truncated);
+            ValueView k(reinterpret_cast<const char*>(p), reinterpret_cast<const char*>(keyEnd), ENCODING_BINARY);
+            const unsigned char* valueEnd = skipCbor(keyEnd, e, maxDepth, truncated);
+            if (k.equals(key, size, string)) {
+                return ValueView(reinterpret_cast<const char*>(keyEnd), reinterpret_cast<const char*>(valueEnd), ENCODING_BINARY);
+            }
+            p = valueEnd;
+        }
+    }
+
+    return ValueView();
+}
+
+bool ValueView::equals(const char* string, int size, const QString* other) const {
+    // the other string is either UTF-8 or a QString
+    const char* content;
+    int length;
+    if (encoding == ENCODING_JSON) {
+        if (*begin != '"') {
+            return false;
+        }
+
+        content = begin + 1;
+        length = getSize() - 2;
+
+        // escaped strings are compared decoded
+        if (memchr(content, '\\', length) != NULL) {
+            Value::String decoded = getString();
+
+            return (other != NULL) ? decoded == *other : decoded == QString::fromUtf8(string, size);
+        }
+    } else if (encoding == ENCODING_BINARY) {
+        int major;
+        quint64 argument;
+        const unsigned char* p = untagCbor(reinterpret_cast<const unsigned char*>(begin), reinterpret_cast<const unsigned char*>(end), major, argument);
+        if (major != 3) {
+            return false;
+        }
+
+        content = reinterpret_cast<const char*>(p);
+        length = argument;
+    } else {
+        return false;
+    }
+
+    if (other != NULL) {
+        return equalsUtf8(content, length, *other);
+    }
+
+    return length == size && memcmp(content, string, size) == 0;
+}
+
+/*
+ * ValueSnapshot
+ */
+class ValueSnapshot::Node {
+  public:
+    Node() :
+        ref(1),
+        hash(0),
+        type(Value::TYPE_UNDEFINED) {
+
+    }
+
+    QAtomicInt ref;
+    uint hash;
+    Value::Type type;
+    // the whole subtree, sharing its payloads with the values of the children
+    Value value;
+    // arrays of numbers have no children, their elements are kept packed in the value
+    QVector<ValueKey> keys;
+    QVector<Node*> children;
+};
+
+QMutex ValueSnapshot::mutex;
+QMultiHash<uint, ValueSnapshot::Node*> ValueSnapshot::nodes;
+
+static inline uint combineHash(uint hash, uint value) {
+    return hash ^ (value + 0x9e3779b9 + (hash << 6) + (hash >> 2));
+}
+
+static inline uint hashFloat(double value) {
+    // 0.0 and -0.0 are equal and need the same hash
+    if (value == 0) {
+        value = 0;
+    }
+
+    quint64 bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    return ::qHash(bits);
+}
+
+ValueSnapshot::ValueSnapshot() :
+    node(NULL) {
+
+}
+
+ValueSnapshot::ValueSnapshot(const Value& value) {
+    // nodes outlive any arena which might be active
+    ValueArena::Scope scope(NULL);
+    node = create(value);
+}
+
+ValueSnapshot::ValueSnapshot(const ValueSnapshot& other) :
+    node(other.node) {
+    if (node != NULL) {
+        node->ref.ref();
+    }
+}
+
+ValueSnapshot::ValueSnapshot(Node* node) :
+    node(node) {
+    if (node != NULL) {
+        node->ref.ref();
+    }
+}
+
+ValueSnapshot::~ValueSnapshot() {
+    release(node);
+}
+
+bool ValueSnapshot::isValid() const {
+    return node != NULL;
+}
+
+Value::Type ValueSnapshot::getType() const {
+    if (node == NULL) {
+        return Value::TYPE_UNDEFINED;
+    }
+
+    return node->type;
+}
+
+uint ValueSnapshot::getHash() const {
+    if (node == NULL) {
+        return 0;
+    }
+
+    return node->hash;
+}
+
+Value ValueSnapshot::toValue() const {
+    if (node == NULL) {
+        return Value();
+    }
+
+    return node->value;
+}
+
+int ValueSnapshot::size() const {
+    if (node == NULL) {
+        return -1;
+    }
+
+    return node->value.size();
+}
+
+bool ValueSnapshot::contains(const ValueKey& key) const {
+    if (node == NULL || node->type != Value::TYPE_OBJECT) {
+        return false;
+    }
+
+    QVector<ValueKey>::const_iterator it = std::lower_bound(node->keys.constBegin(), node->keys.constEnd(), key);
+
+    return it != node->keys.constEnd() && *it == key;
+}
+
+ValueSnapshot ValueSnapshot::operator[](const ValueKey& key) const {
+    if (node == NULL || node->type != Value::TYPE_OBJECT) {
+        return ValueSnapshot();
+    }
+
+    QVector<ValueKey>::const_iterator it = std::lower_bound(node->keys.constBegin(), node->keys.constEnd(), key);
+    if (it == node->keys.constEnd() || *it != key) {
+        return ValueSnapshot();
+    }
+
+    return ValueSnapshot(node->children[it - node->keys.constBegin()]);
+}
+
+ValueSnapshot ValueSnapshot::operator[](int i) const {
+    if (node == NULL || node->type != Value::TYPE_ARRAY || i < 0 || i >= node->value.size()) {
+        return ValueSnapshot();
+    }
+
+    if (node->children.isEmpty()) {
+        return ValueSnapshot(node->value.at(i));
+    }
+
+    return ValueSnapshot(node->children[i]);
+}
+
+const ValueSnapshot& ValueSnapshot::operator=(const ValueSnapshot& other) {
+    if (other.node != NULL) {
+        other.node->ref.ref();
+    }
+    release(node);
+    node = other.node;
+
+    return *this;
+}
+
+bool ValueSnapshot::operator==(const ValueSnapshot& other) const {
+    // structurally equal values always share the same node
+    return node == other.node;
+}
+
+bool ValueSnapshot::operator!=(const ValueSnapshot& other) const {
+    return node != other.node;
+}
+
+int ValueSnapshot::getNodeCount() {
+    QMutexLocker locker(&mutex);
+
+    return nodes.size();
+}
+
+ValueSnapshot::Node* ValueSnapshot::create(const Value& value) {
+    Node* node = new Node();
+    node->type = value.getType();
+    node->hash = ::qHash(static_cast<int>(node->type));
+
+    switch (node->type) {
+    case Value::TYPE_UNDEFINED:
+        node->value.undefined();
+        break;
+    case Value::TYPE_BOOLEAN:
+        node->value = value.getBoolean();
+        node->hash = combineHash(node->hash, value.getBoolean() ? 1 : 0);
+        break;
+    case Value::TYPE_INTEGER:
+        node->value = value.getInteger();
+        node->hash = combineHash(node->hash, ::qHash(static_cast<qint64>(value.getInteger())));
+        break;
+    case Value::TYPE_FLOAT:
+        node->value = value.getFloat();
+        node->hash = combineHash(node->hash, hashFloat(value.getFloat()));
+        break;
+    case Value::TYPE_STRING:
+        node->value = value.getStringRef();
+        node->hash = combineHash(node->hash, ::qHash(value.getStringRef()));
+        break;
+    case Value::TYPE_ARRAY: {
+        // plain arrays of numbers are packed, so they are equal to packed arrays with the same elements
+        Value::Type packed = value.getPackedType();
+        if (packed == Value::TYPE_UNDEFINED && value.size() > 0) {
+            const Value::Array& array = value.getArrayRef();
+            packed = array[0].getType();
+            for (int i = 1; i < array.size() && (packed == Value::TYPE_INTEGER || packed == Value::TYPE_FLOAT); i++) {
+                if (array[i].getType() != packed) {
+                    packed = Value::TYPE_UNDEFINED;
+                }
+            }
+        }
+
+        if (packed == Value::TYPE_INTEGER && value.size() > 0) {
+            Value::IntegerArray integers;
+            if (value.getPackedType() == Value::TYPE_INTEGER) {
+                integers = value.getIntegerArrayRef();
+            } else {
+                const Value::Array& array = value.getArrayRef();
+                integers.reserve(array.size());
+                for (int i = 0; i < array.size(); i++) {
+                    integers.append(array[i].getInteger());
+                }
+            }
+
+            for (int i = 0; i < integers.size(); i++) {
+                node->hash = combineHash(node->hash, ::qHash(static_cast<qint64>(integers[i])));
+            }
+            node->value = std::move(integers);
+        } else if (packed == Value::TYPE_FLOAT && value.size() > 0) {
+            Value::FloatArray floats;
+            if (value.getPackedType() == Value::TYPE_FLOAT) {
+                floats = value.getFloatArrayRef();
+            } else {
+                const Value::Array& array = value.getArrayRef();
+                floats.reserve(array.size());
+                for (int i = 0; i < array.size(); i++) {
+                    floats.append(array[i].getFloat());
+                }
+            }
+
+            for (int i = 0; i < floats.size(); i++) {
+                node->hash = combineHash(node->hash, hashFloat(floats[i]));
+            }
+            node->value = std::move(floats);
+        } else {
+            Value::Array elements;
+            elements.reserve(value.size());
+            for (int i = 0; i < value.size(); i++) {
+                Node* child = create(value[i]);
+                node->children.append(child);
+                node->hash = combineHash(node->hash, child->hash);
+                elements.append(child->value);
+            }
+            node->value = std::move(elements);
+        }
+        break;
+    }
+    case Value::TYPE_OBJECT: {
+        const Value::Object& object = value.getObjectRef();
+        Value::Object elements;
+        node->keys.reserve(object.size());
+        node->children.reserve(object.size());
+        for (Value::Object::const_iterator it = object.begin(); it != object.end(); it++) {
+            Node* child = create(it.value());
+            node->keys.append(it.atom());
+            node->children.append(child);
+            node->hash = combineHash(combineHash(node->hash, ::qHash(&it.atom().toString())), child->hash);
+            elements.insert(it.atom(), child->value);
+        }
+        node->value = std::move(elements);
+        break;
+    }
+    default:
+        break;
+    }
+
+    return intern(node);
+}
+
+ValueSnapshot::Node* ValueSnapshot::intern(Node* node) {
+    Node* existing = NULL;
+
+    mutex.lock();
+    QMultiHash<uint, Node*>::const_iterator it = nodes.constFind(node->hash);
+    while (existing == NULL && it != nodes.constEnd() && it.key() == node->hash) {
+        Node* candidate = it.value();
+        if (equals(candidate, node)) {
+            // a node whose last snapshot is being released is about to be removed and must not be revived
+            int ref = candidate->ref.load();
+            while (ref > 0 && !candidate->ref.testAndSetOrdered(ref, ref + 1)) {
+                ref = candidate->ref.load();
+            }
+
+            if (ref > 0) {
+                existing = candidate;
+            }
+        }
+        it++;
+    }
+
+    if (existing == NULL) {
+        nodes.insert(node->hash, node);
+    }
+    mutex.unlock();
+
+    if (existing != NULL) {
+        release(node);
+
+        return existing;
+    }
+
+    return node;
+}
 
+void ValueSnapshot::release(Node* node) {
+    if (node == NULL || node->ref.deref()) {
+        return;
+    }
+
+    mutex.lock();
+    nodes.remove(node->hash, node);
+    mutex.unlock();
+
+    for (int i = 0; i < node->children.size(); i++) {
+        release(node->children[i]);
+    }
+
+    delete node;
 }
 
-ArbitraryValueException::~ArbitraryValueException() throw() {
+bool ValueSnapshot::equals(const Node* a, const Node* b) {
+    if (a->hash != b->hash || a->type != b->type) {
+        return false;
+    }
+
+    switch (a->type) {
+    case Value::TYPE_BOOLEAN:
+    case Value::TYPE_INTEGER:
+    case Value::TYPE_FLOAT:
+    case Value::TYPE_STRING:
+        return a->value == b->value;
+    case Value::TYPE_ARRAY:
+        // children are interned already, comparing their pointers is enough
+        if (a->children.isEmpty() && b->children.isEmpty()) {
+            return a->value.getPackedType() == b->value.getPackedType() && a->value == b->value;
+        }
 
+        return a->children == b->children;
+    case Value::TYPE_OBJECT:
+        return a->keys == b->keys && a->children == b->children;
+    default:
+        return true;
+    }
 }
 
-const char* ArbitraryValueException::what() const throw() {
-    return message.toStdString().c_str();
+uint hfsmexec::qHash(const ValueSnapshot& snapshot, uint seed) {
+    return snapshot.getHash() ^ seed;
 }
 
 /*
- * ArbitraryValueTypeContainer
+ * ValueArena
  */
-template<typename T>
-struct ArbitraryValueTypeContainer;
+const Logger* ValueArena::logger = Logger::getLogger(LOGGER_VALUE);
+thread_local ValueArena* ValueArena::currentArena = NULL;
 
-template<>
-struct ArbitraryValueTypeContainer<Value::Undefined> {
-    static const Value::Type type = Value::TYPE_UNDEFINED;
-};
+ValueArena::Scope::Scope(ValueArena* arena) :
+    previous(currentArena) {
+    currentArena = arena;
+}
 
-template<>
-struct ArbitraryValueTypeContainer<Value::Null> {
-    static const Value::Type type = Value::TYPE_NULL;
-};
+ValueArena::Scope::~Scope() {
+    currentArena = previous;
+}
 
-template<>
-struct ArbitraryValueTypeContainer<Value::Boolean> {
-    static const Value::Type type = Value::TYPE_BOOLEAN;
-};
+ValueArena::ValueArena(int blockSize) :
+    blockSize(blockSize),
+    block(-1),
+    pos(NULL),
+    end(NULL),
+    values(0) {
 
-template<>
-struct ArbitraryValueTypeContainer<Value::Integer> {
-    static const Value::Type type = Value::TYPE_INTEGER;
-};
+}
 
-template<>
-struct ArbitraryValueTypeContainer<Value::Float> {
-    static const Value::Type type = Value::TYPE_FLOAT;
-};
+ValueArena::~ValueArena() {
+    // values which are still alive would be left pointing into freed memory, leak the blocks instead
+    if (values.load() > 0) {
+        logger->warning(QString("value arena destroyed with %1 values still alive").arg(values.load()));
 
-template<>
-struct ArbitraryValueTypeContainer<Value::String> {
-    static const Value::Type type = Value::TYPE_STRING;
-};
+        return;
+    }
 
-template<>
-struct ArbitraryValueTypeContainer<Value::Array> {
-    static const Value::Type type = Value::TYPE_ARRAY;
-};
+    for (int i = 0; i < blocks.size(); i++) {
+        delete[] blocks[i];
+    }
+}
 
-template<>
-struct ArbitraryValueTypeContainer<Value::Object> {
-    static const Value::Type type = Value::TYPE_OBJECT;
-};
+bool ValueArena::reset() {
+    if (values.load() > 0) {
+        logger->warning(QString("couldn't reset value arena, %1 values are still alive").arg(values.load()));
+
+        return false;
+    }
+
+    // blocks are kept for the next message
+    block = -1;
+    pos = NULL;
+    end = NULL;
+
+    return true;
+}
+
+int ValueArena::getBlockCount() const {
+    return blocks.size();
+}
+
+int ValueArena::getValueCount() const {
+    return values.load();
+}
+
+ValueArena* ValueArena::current() {
+    return currentArena;
+}
+
+void* ValueArena::allocate(size_t size) {
+    // keep every allocation aligned for the next one
+    size = (size + sizeof(double) - 1) & ~(sizeof(double) - 1);
+    if (pos == NULL || size > (size_t)(end - pos)) {
+        if ((int)size > blockSize) {
+            return NULL;
+        }
+
+        block++;
+        if (block == blocks.size()) {
+            blocks.append(new char[blockSize]);
+        }
+        pos = blocks[block];
+        end = pos + blockSize;
+    }
+
+    void* p = pos;
+    pos += size;
+    values.ref();
+
+    return p;
+}
+
+void ValueArena::release() {
+    // the memory is reclaimed by reset, only count the values which are still alive
+    values.deref();
+}
+
+/*
+ * ArbitraryValueException
+ */
+ArbitraryValueException::ArbitraryValueException() :
+    message("ArbitraryValueException") {
+
+}
+
+ArbitraryValueException::ArbitraryValueException(const QString& message):
+    message(message) {
+
+}
+
+ArbitraryValueException::~ArbitraryValueException() throw() {
+
+}
+
+const char* ArbitraryValueException::what() const throw() {
+    return message.toStdString().c_str();
+}
 
 /*
  * ArbitraryValue
  */
-ArbitraryValue::ArbitraryValue() {
+
+// every ArbitraryValue is preceded by the arena it was allocated from, NULL if it was allocated on the heap
+union ArbitraryValueHeader {
+    ValueArena* arena;
+    double align;
+};
+ArbitraryValue::ArbitraryValue() :
+    packing(PACKED_NONE),
+    linked(false),
+    elements(NULL) {
     create(Value::TYPE_UNDEFINED);
 }
 
-ArbitraryValue::ArbitraryValue(ArbitraryValue const &other) {
-    create(other.type, other.data);
+ArbitraryValue::ArbitraryValue(ArbitraryValue const &other) :
+    QSharedData(),
+    packing(PACKED_NONE),
+    linked(false),
+    elements(NULL) {
+    create(other.type, other.packing, other.data);
 }
 
 ArbitraryValue::~ArbitraryValue() {
@@ -1102,6 +4515,10 @@ const Value::Type& ArbitraryValue::getType() const {
     return type;
 }
 
+const ArbitraryValue::Packing& ArbitraryValue::getPacking() const {
+    return packing;
+}
+
 void* ArbitraryValue::ptr() {
     return static_cast<void*>(&data);
 }
@@ -1117,11 +4534,22 @@ T& ArbitraryValue::get() {
         throw ArbitraryValueException("invalid type");
     }
 
+    if(ArbitraryValueTypeContainer<T>::packing != packing) {
+        if(ArbitraryValueTypeContainer<T>::packing != PACKED_NONE) {
+            throw ArbitraryValueException("invalid packing");
+        }
+        unpack();
+    }
+
     switch(type) {
     case Value::TYPE_UNDEFINED:
     case Value::TYPE_NULL:
         throw ArbitraryValueException("non-fetchable type");
     default:
+        // the packed content might be changed through the returned reference
+        discardUnpacked();
+        unshare();
+
         return *static_cast<T*>(ptr());
     }
 }
@@ -1133,6 +4561,16 @@ T const& ArbitraryValue::get() const {
         throw ArbitraryValueException("invalid type");
     }
 
+    // the payload might be shared with other threads and referenced as packed array, so the elements of a packed
+    // array are referenced from a separate copy instead of unpacking it
+    if(ArbitraryValueTypeContainer<T>::packing != packing) {
+        if(ArbitraryValueTypeContainer<T>::packing != PACKED_NONE) {
+            throw ArbitraryValueException("invalid packing");
+        }
+
+        return *reinterpret_cast<T const*>(&unpacked());
+    }
+
     switch(type) {
     case Value::TYPE_UNDEFINED:
     case Value::TYPE_NULL:
@@ -1144,14 +4582,76 @@ T const& ArbitraryValue::get() const {
 
 template<typename T>
 void ArbitraryValue::set(T const& other) {
+    // copy first, other might be part of this value
+    T copy(other);
     destroy();
-    create<T>(other);
+    create<T>(copy);
+}
+
+void ArbitraryValue::set(Value::String&& other) {
+    emplace(other);
+}
+
+void ArbitraryValue::set(Value::Array&& other) {
+    emplace(other);
+}
+
+void ArbitraryValue::set(Value::Object&& other) {
+    emplace(other);
+}
+
+void ArbitraryValue::set(Value::IntegerArray&& other) {
+    emplace(other);
+}
+
+void ArbitraryValue::set(Value::FloatArray&& other) {
+    emplace(other);
 }
 
 void ArbitraryValue::set(ArbitraryValue const& other) {
     if(this != &other) {
+        ArbitraryValue copy(other);
+        take(copy);
+    }
+}
+
+void ArbitraryValue::set(Value const& other) {
+    if (other.heap) {
+        set(*other.data.p);
+    } else {
         destroy();
-        create(other.type, other.data);
+        type = other.type;
+        memcpy(&data, &other.data, sizeof(other.data));
+    }
+}
+
+int ArbitraryValue::size() const {
+    if(type != Value::TYPE_ARRAY) {
+        return 0;
+    }
+
+    switch(packing) {
+    case PACKED_INTEGER:
+        return static_cast<Value::IntegerArray const*>(ptr())->size();
+    case PACKED_FLOAT:
+        return static_cast<Value::FloatArray const*>(ptr())->size();
+    default:
+        return static_cast<Value::Array const*>(ptr())->size();
+    }
+}
+
+Value ArbitraryValue::at(int i) const {
+    if(i < 0 || i >= size()) {
+        return Value();
+    }
+
+    switch(packing) {
+    case PACKED_INTEGER:
+        return Value(static_cast<Value::IntegerArray const*>(ptr())->at(i));
+    case PACKED_FLOAT:
+        return Value(static_cast<Value::FloatArray const*>(ptr())->at(i));
+    default:
+        return static_cast<Value::Array const*>(ptr())->at(i);
     }
 }
 
@@ -1160,6 +4660,20 @@ bool ArbitraryValue::operator==(ArbitraryValue const& other) const {
         return false;
     }
 
+    if(type == Value::TYPE_ARRAY && packing != other.packing) {
+        int n = size();
+        if(n != other.size()) {
+            return false;
+        }
+        for(int i = 0; i < n; i++) {
+            if(at(i) != other.at(i)) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
     switch(type) {
     case Value::TYPE_BOOLEAN:
         return get<Value::Boolean>() == other.get<Value::Boolean>();
@@ -1172,7 +4686,14 @@ bool ArbitraryValue::operator==(ArbitraryValue const& other) const {
     case Value::TYPE_OBJECT:
         return get<Value::Object>() == other.get<Value::Object>();
     case Value::TYPE_ARRAY:
-        return get<Value::Array>() == other.get<Value::Array>();
+        switch(packing) {
+        case PACKED_INTEGER:
+            return get<Value::IntegerArray>() == other.get<Value::IntegerArray>();
+        case PACKED_FLOAT:
+            return get<Value::FloatArray>() == other.get<Value::FloatArray>();
+        default:
+            return get<Value::Array>() == other.get<Value::Array>();
+        }
     default:
         return false;
     }
@@ -1182,6 +4703,7 @@ template<typename T>
 void ArbitraryValue::create(T const &v) {
     void* p = ptr();
     type = ArbitraryValueTypeContainer<T>::type;
+    packing = ArbitraryValueTypeContainer<T>::packing;
     switch(type) {
     case Value::TYPE_UNDEFINED:
     case Value::TYPE_NULL:
@@ -1197,13 +4719,30 @@ void ArbitraryValue::create(T const &v) {
         new(p) Value::Object(reinterpret_cast<Value::Object const&>(v));
         break;
     case Value::TYPE_ARRAY:
-        new(p) Value::Array(reinterpret_cast<Value::Array const&>(v));
+        if(packing == PACKED_INTEGER) {
+            new(p) Value::IntegerArray(reinterpret_cast<Value::IntegerArray const&>(v));
+        } else if(packing == PACKED_FLOAT) {
+            new(p) Value::FloatArray(reinterpret_cast<Value::FloatArray const&>(v));
+        } else {
+            new(p) Value::Array(reinterpret_cast<Value::Array const&>(v));
+        }
         break;
     }
 }
 
+template<typename T>
+void ArbitraryValue::emplace(T& v) {
+    // move first, v might be part of this value
+    T tmp(std::move(v));
+    destroy();
+    type = ArbitraryValueTypeContainer<T>::type;
+    packing = ArbitraryValueTypeContainer<T>::packing;
+    new(ptr()) T(std::move(tmp));
+}
+
 void ArbitraryValue::create(Value::Type t) {
     type = t;
+    packing = PACKED_NONE;
     memset(ptr(), 0, sizeof(data));
     switch(type) {
     case Value::TYPE_UNDEFINED:
@@ -1224,9 +4763,10 @@ void ArbitraryValue::create(Value::Type t) {
     }
 }
 
-void ArbitraryValue::create(Value::Type t, Data const& other) {
+void ArbitraryValue::create(Value::Type t, Packing pk, Data const& other) {
     void* p = &data;
     type = t;
+    packing = pk;
     switch(t) {
     case Value::TYPE_UNDEFINED:
     case Value::TYPE_NULL:
@@ -1239,10 +4779,18 @@ void ArbitraryValue::create(Value::Type t, Data const& other) {
         new(p) Value::String(reinterpret_cast<Value::String const&>(other));
         break;
     case Value::TYPE_OBJECT:
-        new(p) Value::Object(reinterpret_cast<Value::Object const&>(other));
+        // copy the elements right away, links in the copy are resolved to their current value
+        (new(p) Value::Object(reinterpret_cast<Value::Object const&>(other)))->detach();
         break;
     case Value::TYPE_ARRAY:
-        new(p) Value::Array(reinterpret_cast<Value::Array const&>(other));
+        // packed arrays hold no values which could be linked, the implicitly shared vector is enough
+        if(pk == PACKED_INTEGER) {
+            new(p) Value::IntegerArray(reinterpret_cast<Value::IntegerArray const&>(other));
+        } else if(pk == PACKED_FLOAT) {
+            new(p) Value::FloatArray(reinterpret_cast<Value::FloatArray const&>(other));
+        } else {
+            (new(p) Value::Array(reinterpret_cast<Value::Array const&>(other)))->detach();
+        }
         break;
     }
 }
@@ -1251,6 +4799,8 @@ void ArbitraryValue::destroy() {
     typedef Value::String String;
     typedef Value::Object Object;
     typedef Value::Array Array;
+    typedef Value::IntegerArray IntegerArray;
+    typedef Value::FloatArray FloatArray;
 
     switch(type) {
     case Value::TYPE_UNDEFINED:
@@ -1266,33 +4816,182 @@ void ArbitraryValue::destroy() {
         static_cast<Value::Object*>(ptr())->~Object();
         break;
     case Value::TYPE_ARRAY:
-        static_cast<Value::Array*>(ptr())->~Array();
+        if(packing == PACKED_INTEGER) {
+            static_cast<Value::IntegerArray*>(ptr())->~IntegerArray();
+        } else if(packing == PACKED_FLOAT) {
+            static_cast<Value::FloatArray*>(ptr())->~FloatArray();
+        } else {
+            static_cast<Value::Array*>(ptr())->~Array();
+        }
         break;
     }
 
+    discardUnpacked();
+    packing = PACKED_NONE;
     memset(&data, 0, sizeof(data));
 }
 
+void ArbitraryValue::take(ArbitraryValue& other) {
+    destroy();
+    type = other.type;
+    packing = other.packing;
+    memcpy(&data, &other.data, sizeof(data));
+    elements.store(other.elements.fetchAndStoreOrdered(NULL));
+
+    other.type = Value::TYPE_UNDEFINED;
+    other.packing = PACKED_NONE;
+    memset(&other.data, 0, sizeof(other.data));
+}
+
+void ArbitraryValue::unshare() {
+    // the container might still be shared with a copy of this value. Detaching it through Qt would copy every element
+    // and break links in this value, so the elements are shared with the copy instead.
+    if (type == Value::TYPE_ARRAY && packing == PACKED_NONE) {
+        unshare(*static_cast<Value::Array*>(ptr()));
+    } else if (type == Value::TYPE_OBJECT) {
+        unshare(static_cast<Value::Object*>(ptr())->values);
+    }
+}
+
+void* ArbitraryValue::operator new(size_t size) {
+    ValueArena* arena = ValueArena::current();
+    ArbitraryValueHeader* header = NULL;
+    if (arena != NULL) {
+        header = static_cast<ArbitraryValueHeader*>(arena->allocate(sizeof(ArbitraryValueHeader) + size));
+    }
+
+    // values too large for a block of the arena fall back to the heap
+    if (header == NULL) {
+        arena = NULL;
+        header = static_cast<ArbitraryValueHeader*>(::operator new(sizeof(ArbitraryValueHeader) + size));
+    }
+    header->arena = arena;
+
+    return header + 1;
+}
+
+void ArbitraryValue::operator delete(void* p) {
+    if (p == NULL) {
+        return;
+    }
+
+    ArbitraryValueHeader* header = static_cast<ArbitraryValueHeader*>(p) - 1;
+    if (header->arena != NULL) {
+        header->arena->release();
+    } else {
+        ::operator delete(header);
+    }
+}
+
+ValueArena* ArbitraryValue::arenaOf(const ArbitraryValue* value) {
+    return (reinterpret_cast<const ArbitraryValueHeader*>(value) - 1)->arena;
+}
+
+void ArbitraryValue::promote() {
+    // the content of the children doesn't change, so they are promoted in place even if this value is shared
+    if (type == Value::TYPE_ARRAY && packing == PACKED_NONE) {
+        Value::Array& array = get<Value::Array>();
+        for (int i = 0; i < array.size(); i++) {
+            array[i].promote();
+        }
+    } else if (type == Value::TYPE_OBJECT) {
+        Value::Object& object = get<Value::Object>();
+        for (Value::Object::iterator it = object.begin(); it != object.end(); it++) {
+            it.value().promote();
+        }
+    }
+}
+
+void ArbitraryValue::unpack() {
+    if (type != Value::TYPE_ARRAY || packing == PACKED_NONE) {
+        return;
+    }
+
+    int n = size();
+    Value::Array array;
+    array.reserve(n);
+    for (int i = 0; i < n; i++) {
+        array.append(at(i));
+    }
+
+    destroy();
+    new(ptr()) Value::Array(std::move(array));
+}
+
+const Value::Array& ArbitraryValue::unpacked() const {
+    Value::Array* array = elements.loadAcquire();
+    if (array != NULL) {
+        return *array;
+    }
+
+    int n = size();
+    array = new Value::Array();
+    array->reserve(n);
+    for (int i = 0; i < n; i++) {
+        array->append(at(i));
+    }
+
+    // another thread might have been faster, its copy is used then
+    if (!elements.testAndSetOrdered(NULL, array)) {
+        delete array;
+        array = elements.loadAcquire();
+    }
+
+    return *array;
+}
+
+void ArbitraryValue::discardUnpacked() {
+    delete elements.fetchAndStoreOrdered(NULL);
+}
+
+void ArbitraryValue::unshare(Value::Array& array) {
+    if (array.isDetached()) {
+        return;
+    }
+
+    Value::Array copy;
+    copy.reserve(array.size());
+    for (int i = 0; i < array.size(); i++) {
+        copy.append(Value());
+        copy.last().share(array.at(i));
+    }
+    array = copy;
+}
+
 /*
  * ValueScriptBinding
  */
+QMutex ValueScriptBinding::mutex;
+QHash<QScriptEngine*, ValueScriptBinding*> ValueScriptBinding::bindings;
+
 ValueScriptBinding::ValueScriptBinding(QScriptEngine* engine) :
+    QObject(engine),
     QScriptClass(engine) {
 
 }
 
 ValueScriptBinding::~ValueScriptBinding() {
-
+    // the binding is a child of its engine and destroyed together with it
+    mutex.lock();
+    bindings.remove(engine());
+    mutex.unlock();
 }
 
 QScriptValue ValueScriptBinding::property(const QScriptValue& object, const QScriptString& name, uint id) {
-    Value* value = qscriptvalue_cast<Value*>(object.data());
+    // reads only use const lookups, a payload shared with other values isn't copied
+    const Value* value = getValue(object);
     if (!value) {
         return QScriptValue();
     }
 
     // get value from array or object
     if (value->isArray() && name.toArrayIndex() < value->size()) {
+        // elements of packed arrays are numbers, reading them doesn't need to unpack the array
+        if (value->getPackedType() == Value::TYPE_INTEGER) {
+            return QScriptValue(static_cast<double>(value->getIntegerArrayRef().at(name.toArrayIndex())));
+        } else if (value->getPackedType() == Value::TYPE_FLOAT) {
+            return QScriptValue(value->getFloatArrayRef().at(name.toArrayIndex()));
+        }
         value = &((*value)[name.toArrayIndex()]);
     } else if (value->isObject() && value->contains(name.toString())) {
         value = &((*value)[name.toString()]);
@@ -1304,28 +5003,25 @@ QScriptValue ValueScriptBinding::property(const QScriptValue& object, const QScr
     if (value->isBoolean()) {
         return QScriptValue(value->getBoolean());
     } else if (value->isInteger()) {
-        return QScriptValue((int)value->getInteger()); // TODO
+        return QScriptValue(static_cast<double>(value->getInteger()));
     } else if (value->isFloat()) {
         return QScriptValue(value->getFloat());
     } else if (value->isString()) {
         return QScriptValue(value->getString());
-    } else if (value->isArray()) {
-        QScriptValue scriptValue = engine()->newVariant(QVariant::fromValue(value));
-        QScriptValue wrappedValue = engine()->newObject(this, scriptValue);
-
-        return wrappedValue;
-    } else if (value->isObject()) {
-        QScriptValue scriptValue = engine()->newVariant(QVariant::fromValue(value));
-        QScriptValue wrappedValue = engine()->newObject(this, scriptValue);
+    } else if (value->isArray() || value->isObject()) {
+        // nested wrappers refer to their parent and name, so writes through them can detach the whole path
+        QScriptValue data = engine()->newObject();
+        data.setProperty("parent", object);
+        data.setProperty("name", name.toString());
 
-        return wrappedValue;
+        return engine()->newObject(this, data);
     }
 
     return QScriptValue();
 }
 
 void ValueScriptBinding::setProperty(QScriptValue& object, const QScriptString& name, uint id, const QScriptValue& newValue) {
-    Value* value = qscriptvalue_cast<Value*>(object.data());
+    Value* value = getMutableValue(object);
     if (!value) {
         return;
     }
@@ -1365,14 +5061,90 @@ QScriptClass::QueryFlags ValueScriptBinding::queryProperty(const QScriptValue& o
     return 0;
 }
 
+ValueScriptBinding* ValueScriptBinding::getBinding(QScriptEngine* engine) {
+    QMutexLocker locker(&mutex);
+
+    ValueScriptBinding*& binding = bindings[engine];
+    if (binding == NULL) {
+        binding = new ValueScriptBinding(engine);
+    }
+
+    return binding;
+}
+
 QScriptValue ValueScriptBinding::create(QScriptEngine* engine, Value* value) {
-    ValueScriptBinding* valueScriptBinding = new ValueScriptBinding(engine); // TODO will cause memory leak
+    ValueScriptBinding* binding = getBinding(engine);
+
+    // wrappers only hold the pointer to the value, the same wrapper is handed out for every evaluation
+    QHash<Value*, QScriptValue>::const_iterator it = binding->wrappers.constFind(value);
+    if (it != binding->wrappers.constEnd()) {
+        return it.value();
+    }
+
     QScriptValue scriptValue = engine->newVariant(QVariant::fromValue(value));
-    QScriptValue wrappedValue = engine->newObject(valueScriptBinding, scriptValue);
+    QScriptValue wrappedValue = engine->newObject(binding, scriptValue);
+    binding->wrappers.insert(value, wrappedValue);
 
     return wrappedValue;
 }
 
+int ValueScriptBinding::getBindingCount() {
+    QMutexLocker locker(&mutex);
+
+    return bindings.size();
+}
+
+int ValueScriptBinding::getWrapperCount() const {
+    return wrappers.size();
+}
+
+const Value* ValueScriptBinding::getValue(const QScriptValue& object) {
+    QScriptValue data = object.data();
+    if (data.isVariant()) {
+        return qscriptvalue_cast<Value*>(data);
+    }
+
+    if (!data.isObject()) {
+        return NULL;
+    }
+
+    const Value* parent = getValue(data.property("parent"));
+    if (parent == NULL) {
+        return NULL;
+    }
+
+    QString name = data.property("name").toString();
+    const Value& value = parent->isArray() ? (*parent)[name.toInt()] : (*parent)[name];
+
+    return (&value != &NullValue::ref()) ? &value : NULL;
+}
+
+Value* ValueScriptBinding::getMutableValue(const QScriptValue& object) {
+    QScriptValue data = object.data();
+    if (data.isVariant()) {
+        return qscriptvalue_cast<Value*>(data);
+    }
+
+    if (!data.isObject()) {
+        return NULL;
+    }
+
+    Value* parent = getMutableValue(data.property("parent"));
+    if (parent == NULL) {
+        return NULL;
+    }
+
+    // the non-const lookups detach the payloads along the path
+    QString name = data.property("name").toString();
+    if (parent->isArray() && name.toInt() < parent->size()) {
+        return &(*parent)[name.toInt()];
+    } else if (parent->isObject() && parent->contains(name)) {
+        return &(*parent)[name];
+    }
+
+    return NULL;
+}
+
 void ValueScriptBinding::setPropertyFromArray(const QVariantList& list, Value* value) {
     for (int i = 0; i < list.size(); i++) {
         const QVariant& v = list.at(i);
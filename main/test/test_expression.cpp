@@ -0,0 +1,206 @@
+/*
+ *  Copyright (C) 2014 Marcel Lehwald
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gtest/gtest.h>
+#include <expression.h>
+
+#include <QScriptEngine>
+
+using namespace hfsmexec;
+
+class ExpressionTest : public ::testing::Test {
+  protected:
+    QScriptEngine engine;
+    Value input;
+    Value output;
+
+    virtual void SetUp() {
+        QByteArray json = "{\"retries\":2,\"name\":\"goal\",\"count\":\"10\",\"enabled\":true,\"empty\":null,\"list\":[1,2,3],\"big\":4294967296,\"ids\":[4294967296,1],\"nested\":{\"values\":[{\"id\":\"a\"},{\"id\":\"b\"}]}}";
+        input.fromJson(json.constData(), json.size());
+        output["status"] = 3;
+        output["ratio"] = 0.5;
+        output["message"] = "done";
+    }
+
+    bool script(const QString& condition) {
+        QScriptContext* context = engine.pushContext();
+        context->activationObject().setProperty("input", ValueScriptBinding::create(&engine, &input));
+        context->activationObject().setProperty("output", ValueScriptBinding::create(&engine, &output));
+        QScriptValue result = engine.evaluate(condition);
+        bool exception = engine.hasUncaughtException();
+        engine.clearExceptions();
+        engine.popContext();
+
+        return !exception && result.toBool();
+    }
+};
+
+TEST_F(ExpressionTest, matchesScript)
+{
+    const char* conditions[] = {
+        "output.status == 3 && input.retries < 5",
+        "output.status == 3 && input.retries > 5",
+        "output.status != 3 || input.enabled",
+        "input.name == 'goal' && output.message === \"done\"",
+        "input.count == 10",
+        "input.count === 10",
+        "input.count > 9",
+        "input.name < 'h'",
+        "input.missing == undefined",
+        "input.missing == null",
+        "input.missing === null",
+        "input.empty == null",
+        "input.list[1] == 2 && input.list[5] == undefined",
+        "input.list.length == 3",
+        "input.big == 4294967296 && input.big > 2147483647",
+        "input.ids[0] == input.big && input.ids[1] == 1",
+        "input.nested.values[1].id == 'b'",
+        "input['name'] == 'goal'",
+        "input.name.length == 4",
+        "!input.enabled",
+        "!!input.list",
+        "-input.retries == -2",
+        "+input.count == 10",
+        "(input.retries + 1) * 2 == 6",
+        "output.ratio * 4 % 3 == 2",
+        "input.retries / 0 > 1000",
+        "input.name + '1' == 'goal1'",
+        "input.retries > 1 ? output.status == 3 : false",
+        "input.retries > 2 ? true : output.ratio",
+        "input.enabled == 1",
+        "'' || 0",
+        "'abc' > 'abd'",
+        "input.name > 1",
+        "0x10 == 16 && 1e2 == 100 && .5 == 0.5"
+    };
+
+    for (unsigned int i = 0; i < sizeof(conditions) / sizeof(conditions[0]); i++) {
+        Expression expression;
+        ASSERT_TRUE(expression.compile(conditions[i])) << conditions[i] << ": " << expression.getError().toStdString();
+
+        bool result;
+        ASSERT_TRUE(expression.evaluate(input, output, result)) << conditions[i];
+        EXPECT_EQ(script(conditions[i]), result) << conditions[i];
+    }
+}
+
+TEST_F(ExpressionTest, unsupported)
+{
+    //these have to be left to QtScript
+    const char* conditions[] = {
+        "Math.abs(input.retries) > 1",
+        "input.retries++ > 1",
+        "input.list[input.retries] == 3",
+        "input.name.toString() == 'goal'",
+        "typeof input.name == 'string'",
+        "input.retries = 5",
+        "input.retries & 1",
+        "010 == 8",
+        "input.name == 'goal' &&"
+    };
+
+    for (unsigned int i = 0; i < sizeof(conditions) / sizeof(conditions[0]); i++) {
+        Expression expression;
+        EXPECT_FALSE(expression.compile(conditions[i])) << conditions[i];
+        EXPECT_FALSE(expression.isValid());
+        EXPECT_FALSE(expression.getError().isEmpty());
+    }
+
+    //decided at runtime, evaluate() refuses instead of guessing
+    const char* runtime[] = {
+        "input.nested == input.nested",
+        "input.list == '1,2,3'",
+        "input.missing.foo == 1",
+        "input.name + 1 == 'goal1'"
+    };
+
+    for (unsigned int i = 0; i < sizeof(runtime) / sizeof(runtime[0]); i++) {
+        Expression expression;
+        ASSERT_TRUE(expression.compile(runtime[i])) << runtime[i];
+
+        bool result;
+        EXPECT_FALSE(expression.evaluate(input, output, result)) << runtime[i];
+    }
+}
+
+TEST_F(ExpressionTest, transformation)
+{
+    Expression expression;
+    Value result;
+
+    ASSERT_TRUE(expression.compile("output.ratio * 4 + input.retries"));
+    ASSERT_TRUE(expression.evaluate(input, output, result));
+    EXPECT_EQ(Value::TYPE_FLOAT, result.getType());
+    EXPECT_EQ(4.0, result.getFloat());
+
+    ASSERT_TRUE(expression.compile("input.name + '.' + output.message"));
+    ASSERT_TRUE(expression.evaluate(input, output, result));
+    EXPECT_EQ("goal.done", result.getString());
+
+    ASSERT_TRUE(expression.compile("input.retries > 5 ? input.list : input.nested.values[0]"));
+    ASSERT_TRUE(expression.evaluate(input, output, result));
+    EXPECT_TRUE(result == input["nested"]["values"][0]);
+
+    ASSERT_TRUE(expression.compile("input.empty == null ? null : 1"));
+    ASSERT_TRUE(expression.evaluate(input, output, result));
+    EXPECT_TRUE(result.isNull());
+
+    ASSERT_TRUE(expression.compile("input.missing"));
+    ASSERT_TRUE(expression.evaluate(input, output, result));
+    EXPECT_TRUE(result.isUndefined());
+}
+
+TEST_F(ExpressionTest, paths)
+{
+    Expression expression;
+    ASSERT_TRUE(expression.compile("input.nested.values[1].id == 'b' && output.status + input['retries'] > output.status"));
+
+    QList<ValuePath> paths = expression.getPaths();
+    ASSERT_EQ(3, paths.size());
+    EXPECT_EQ("input.nested.values[1].id", paths[0].toString());
+    EXPECT_EQ("output.status", paths[1].toString());
+    EXPECT_EQ("input.retries", paths[2].toString());
+
+    ASSERT_TRUE(expression.compile("1 + 2"));
+    EXPECT_TRUE(expression.getPaths().isEmpty());
+}
+
+TEST_F(ExpressionTest, event)
+{
+    Expression expression;
+    Value event;
+    event["temperature"] = 41.5;
+    event["sensor"] = "s1";
+
+    bool result = false;
+    ASSERT_TRUE(expression.compile("event.temperature > 40 && event.sensor == 's1' && input.retries == 2"));
+    ASSERT_TRUE(expression.evaluate(input, output, event, result));
+    EXPECT_TRUE(result);
+
+    // without a payload reading the event is left to QtScript
+    EXPECT_FALSE(expression.evaluate(input, output, result));
+
+    QList<ValuePath> paths = expression.getPaths();
+    ASSERT_EQ(3, paths.size());
+    EXPECT_EQ("event.temperature", paths[0].toString());
+    EXPECT_EQ("event.sensor", paths[1].toString());
+
+    Value value;
+    ASSERT_TRUE(expression.compile("event.temperature * 2"));
+    ASSERT_TRUE(expression.evaluate(input, output, event, value));
+    EXPECT_EQ(83.0, value.getFloat());
+}
@@ -36,15 +36,20 @@ class Rosbridge : public QObject {
     void read();
     bool write(const hfsmexec::Value& value);
 
-    int registerListener(std::function<bool(hfsmexec::Value)> listener);
+    int registerListener(std::function<bool(const hfsmexec::ValueView&)> listener);
     void unregisterListener(int handle);
 
   private:
     static const hfsmexec::Logger* logger;
     QTcpSocket socket;
-    QMap<int, std::function<bool(hfsmexec::Value)>> listeners;
+    QByteArray binaryBuffer;
+    QMap<int, std::function<bool(const hfsmexec::ValueView&)>> listeners;
     QMutex listenersMutex;
     int id;
+
+    void readBinary();
+    void readJson(const char* data, int size);
+    void notifyListeners(const hfsmexec::ValueView& value);
 };
 
 class RosCommunicationPlugin : public QObject, public hfsmexec::CommunicationPlugin {
@@ -69,6 +74,8 @@ class RosCommunicationPlugin : public QObject, public hfsmexec::CommunicationPlu
     void subscribeMessage();
     void sendServiceRequest();
     void sendActionGoal();
+
+    void requestCompression(hfsmexec::Value& message);
 };
 
 #endif
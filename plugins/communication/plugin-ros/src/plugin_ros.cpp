@@ -18,6 +18,7 @@
 #include <plugin_ros.h>
 #include <QUuid>
 #include <iostream>
+#include <cstring>
 
 using namespace hfsmexec;
 
@@ -48,40 +49,29 @@ void Rosbridge::socketError(QAbstractSocket::SocketError socketError) {
 }
 
 void Rosbridge::read() {
-    QByteArray data = socket.readLine();
-    QString message(data);
-
-    logger->info("read rosbridge message: " + message);
-
-    Value value;
-    if (!value.fromJson(message)) {
-        logger->warning("couldn't decode JSON data");
+    // subscriptions with "cbor" compression are answered with CBOR maps, everything else is a JSON line
+    char first;
+    if (!binaryBuffer.isEmpty() || (socket.peek(&first, 1) == 1 && (first & 0xE0) == 0xA0)) {
+        readBinary();
 
         return;
     }
 
-    listenersMutex.lock();
-    QMapIterator<int, std::function<bool(hfsmexec::Value)>> it(listeners);
-    while (it.hasNext()) {
-        it.next();
-        if (it.value()(value)) {
-            listeners.remove(it.key());
-        }
-    }
-    listenersMutex.unlock();
+    QByteArray data = socket.readLine();
+    readJson(data.constData(), data.size());
 }
 
 bool Rosbridge::write(const hfsmexec::Value& value) {
-    QString data;
+    QByteArray data;
     if (!value.toJson(data)) {
         logger->warning("couldn't encode JSON data");
 
         return false;
     }
 
-    logger->info("write rosbridge message: " + data);
+    logger->info("write rosbridge message: " + QString::fromUtf8(data));
 
-    int num = socket.write(data.toUtf8());
+    int num = socket.write(data);
 
     if (num != data.size()) {
         logger->warning(QString("couldn't write all bytes to socket (%1 of %2)").arg(num).arg(data.size()));
@@ -92,10 +82,79 @@ bool Rosbridge::write(const hfsmexec::Value& value) {
     return true;
 }
 
-int Rosbridge::registerListener(std::function<bool(Value)> listener) {
+void Rosbridge::readBinary() {
+    // CBOR items are self-delimiting, a message can be split across reads. The same read might also pull in JSON lines
+    // following a CBOR message, so the first byte of every item tells them apart like in read().
+    binaryBuffer.append(socket.readAll());
+
+    int position = 0;
+    while (position < binaryBuffer.size()) {
+        const char* data = binaryBuffer.constData() + position;
+        int size = binaryBuffer.size() - position;
+
+        if ((*data & 0xE0) == 0xA0) {
+            ValueView view;
+            if (!view.fromBinary(data, size)) {
+                if (view.isTruncated()) {
+                    break;
+                }
+
+                logger->warning("couldn't decode CBOR data");
+                binaryBuffer.clear();
+
+                return;
+            }
+
+            logger->info(QString("read rosbridge CBOR message (%1 bytes)").arg(view.getSize()));
+
+            notifyListeners(view);
+            position += view.getSize();
+        } else {
+            // a JSON line is only read once it is complete
+            const char* newline = static_cast<const char*>(memchr(data, '\n', size));
+            if (newline == NULL) {
+                break;
+            }
+
+            int length = newline - data + 1;
+            readJson(data, length);
+            position += length;
+        }
+    }
+
+    binaryBuffer.remove(0, position);
+}
+
+void Rosbridge::readJson(const char* data, int size) {
+    logger->info("read rosbridge message: " + QString::fromUtf8(data, size));
+
+    // most messages are dropped by every listener, so they are only viewed. Listeners decode the parts they keep.
+    ValueView view;
+    if (!view.fromJson(data, size)) {
+        logger->warning("couldn't decode JSON data");
+
+        return;
+    }
+
+    notifyListeners(view);
+}
+
+void Rosbridge::notifyListeners(const ValueView& value) {
+    listenersMutex.lock();
+    QMapIterator<int, std::function<bool(const hfsmexec::ValueView&)>> it(listeners);
+    while (it.hasNext()) {
+        it.next();
+        if (it.value()(value)) {
+            listeners.remove(it.key());
+        }
+    }
+    listenersMutex.unlock();
+}
+
+int Rosbridge::registerListener(std::function<bool(const ValueView&)> listener) {
     listenersMutex.lock();
     int handle = id++;
-    listeners[handle] = listener;
+    listeners[handle] = std::move(listener);
     listenersMutex.unlock();
 
     return handle;
@@ -168,6 +227,7 @@ void RosCommunicationPlugin::subscribeMessage() {
     subscribe["op"] = "subscribe";
     subscribe["topic"] = endpoint["topic"].getString();
     subscribe["id"] = QUuid::createUuid().toString();
+    requestCompression(subscribe);
     if (!rosbridge.write(subscribe)) {
         error();
         return;
@@ -183,15 +243,21 @@ void RosCommunicationPlugin::subscribeMessage() {
     };
 
     // callback: received message
-    auto receivedMessage = [=](Value& message) {
+    auto receivedMessage = [=](const ValueView& message) {
         logger->info("received message");
 
-        success(message["msg"]);
+        // only the output is decoded, a missing output leaves the state output as it is
+        ValueView output = message["msg"];
+        if (output.isValid()) {
+            success(output.toValue());
+        } else {
+            success();
+        }
     };
 
     // register rosbridge callback
-    int handle = rosbridge.registerListener([=](Value message) {
-        if (!(message["op"].getString() == "publish" &&
+    int handle = rosbridge.registerListener([=](const ValueView& message) {
+        if (!(message["op"] == "publish" &&
                 message["topic"] == subscribe["topic"])) {
             return false;
         }
@@ -215,21 +281,27 @@ void RosCommunicationPlugin::sendServiceRequest() {
     request["op"] = "call_service";
     request["service"] = endpoint["topic"].getString();
     request["args"] = input;
+    requestCompression(request);
     if (!rosbridge.write(request)) {
         error();
         return;
     }
 
     // callback: received response
-    auto receivedResponse = [=](Value& message) {
+    auto receivedResponse = [=](const ValueView& message) {
         logger->info("received service response");
 
-        success(message["values"]);
+        ValueView output = message["values"];
+        if (output.isValid()) {
+            success(output.toValue());
+        } else {
+            success();
+        }
     };
 
     // register rosbridge callback
-    int handle = rosbridge.registerListener([=](Value message) {
-        if (!(message["op"].getString() == "service_response" &&
+    int handle = rosbridge.registerListener([=](const ValueView& message) {
+        if (!(message["op"] == "service_response" &&
                 message["service"] == request["service"])) {
             return false;
         }
@@ -251,6 +323,7 @@ void RosCommunicationPlugin::sendActionGoal() {
     subscribe["op"] = "subscribe";
     subscribe["topic"] = endpoint["topic"].getString() + "/result";
     subscribe["id"] = QUuid::createUuid().toString();
+    requestCompression(subscribe);
     if (!rosbridge.write(subscribe)) {
         error();
         return;
@@ -286,15 +359,20 @@ void RosCommunicationPlugin::sendActionGoal() {
     };
 
     // callback: received result
-    auto receivedResult = [=](Value& message) {
+    auto receivedResult = [=](const ValueView& message) {
         logger->info("received action result");
 
-        success(message["msg"]);
+        ValueView output = message["msg"];
+        if (output.isValid()) {
+            success(output.toValue());
+        } else {
+            success();
+        }
     };
 
     // register rosbridge callback
-    int handle = rosbridge.registerListener([=](Value message) {
-        if (!(message["op"].getString() == "publish" &&
+    int handle = rosbridge.registerListener([=](const ValueView& message) {
+        if (!(message["op"] == "publish" &&
                 message["topic"] == subscribe["topic"] &&
                 message["msg"]["status"]["goal_id"]["id"] == publish["msg"]["goal_id"]["id"])) {
             return false;
@@ -313,3 +391,10 @@ void RosCommunicationPlugin::sendActionGoal() {
         rosbridge.unregisterListener(handle);
     };
 }
+
+void RosCommunicationPlugin::requestCompression(Value& message) {
+    // with "cbor" compression rosbridge answers in binary, which keeps large numeric messages small
+    if (endpoint["compression"].getString() == "cbor") {
+        message["compression"] = "cbor";
+    }
+}
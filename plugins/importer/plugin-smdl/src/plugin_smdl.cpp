@@ -17,7 +17,6 @@
 
 #include <plugin_smdl.h>
 #include <QUuid>
-#include <sstream>
 
 using namespace hfsmexec;
 
@@ -35,8 +34,9 @@ Importer::~Importer() {
 
 StateMachine* Importer::importStateMachine(const QString& data) {
     // parse XML
+    QByteArray utf8 = data.toUtf8();
     pugi::xml_document doc;
-    pugi::xml_parse_result result = doc.load_buffer(data.toStdString().c_str(), data.size());
+    pugi::xml_parse_result result = doc.load_buffer(utf8.constData(), utf8.size());
     if (result.status != pugi::status_ok) {
         logger->warning(QString("couldn't parse XML: %1").arg(result.description()));
 
@@ -135,12 +135,8 @@ bool Importer::decodeTransitions(pugi::xml_node& node, StateMachineBuilder& buil
 bool Importer::decodeInput(pugi::xml_node& node, AbstractState* state) {
     logger->info("decode input");
 
-    std::ostringstream stream;
-    node.print(stream);
-    QString nodeStr = stream.str().c_str();
-
     Value parameters;
-    if (!parameters.fromXml(nodeStr)) {
+    if (!parameters.fromXml(node)) {
         return false;
     }
 
@@ -152,12 +148,8 @@ bool Importer::decodeInput(pugi::xml_node& node, AbstractState* state) {
 bool Importer::decodeOutput(pugi::xml_node& node, AbstractState* state) {
     logger->info("decode output");
 
-    std::ostringstream stream;
-    node.print(stream);
-    QString nodeStr = stream.str().c_str();
-
     Value parameters;
-    if (!parameters.fromXml(nodeStr)) {
+    if (!parameters.fromXml(node)) {
         return false;
     }
 
@@ -238,12 +230,8 @@ AbstractState* Importer::decodeInvoke(pugi::xml_node& node, StateMachineBuilder&
     pugi::xml_node endpoint = node.child("endpoint");
     QString binding = endpoint.attribute("binding").value();
 
-    std::ostringstream stream;
-    endpoint.print(stream);
-    QString endPointStr = stream.str().c_str();
-
     Value endpointParameter;
-    endpointParameter.fromXml(endPointStr);
+    endpointParameter.fromXml(endpoint);
 
     logger->info(QString("decode InvokeState: id=%1, binding=%2, parent=%3").arg(id).arg(binding).arg(parentState->getId()));
 